@@ -0,0 +1,126 @@
+// /bench/bloom_fp.cc
+// Empirical vs theoretical false-positive rate of the gateway "bloom" method
+// for the simulation's ID scheme, id = (index+1)*100000 + seq, under every
+// hash policy of src/dedup/hash_policy.h plus the legacy per-probe hashMix.
+// Theory: (1 - e^(-k n / m))^k for n distinct inserts.
+//
+//   bloom_fp [--json FILE] [--sensors N] [--seq N] [--queries N] [--check]
+//
+// --check exits with status 1 if any policy other than the legacy ones
+// exceeds the theoretical FP by more than 25% (plus sampling noise).
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+#include "dedup/hash_policy.h"
+
+// GatewayNode before hash_policy.h: one std::hash call per probe
+struct LegacyProbes {
+    static const char* name() { return "legacy_hashMix"; }
+    static size_t bit(int id, int k, size_t m) {
+        return std::hash<uint64_t>{}((uint64_t)id ^ ((uint64_t)k * 0x9e3779b97f4a7c15ULL)) % m;
+    }
+};
+
+// Kirsch–Mitzenmacher over one policy hash, as GatewayNode::bloomTest_id
+template <class H>
+struct KmProbes {
+    static const char* name() { return H::name(); }
+    static size_t bit(int id, int k, size_t m) { return KmIndex<H>(id).mod(k, m); }
+};
+
+struct Result {
+    std::string hash;
+    size_t m;
+    int k;
+    long n;
+    long queries;
+    double fpEmp;
+    double fpTheory;
+    bool legacy;
+};
+
+template <class P>
+static Result run(size_t m, int k, int sensors, int seqs, long queries, bool legacy) {
+    std::vector<uint8_t> bits((m + 7) / 8, 0);
+    auto idOf = [](int index, int seq) { return (index + 1) * 100000 + seq; };
+    long n = 0;
+    for (int s = 1; s <= seqs; ++s)
+        for (int i = 0; i < sensors; ++i, ++n)
+            for (int j = 0; j < k; ++j) {
+                size_t b = P::bit(idOf(i, s), j, m);
+                bits[b >> 3] |= (uint8_t)(1u << (b & 7));
+            }
+    // fresh IDs of the same sensors: the sequence numbers that come next
+    long fp = 0, q = 0;
+    for (int s = seqs + 1; q < queries && s < 100000; ++s)
+        for (int i = 0; i < sensors && q < queries; ++i, ++q) {
+            bool all = true;
+            for (int j = 0; j < k && all; ++j) {
+                size_t b = P::bit(idOf(i, s), j, m);
+                all = (bits[b >> 3] >> (b & 7)) & 1u;
+            }
+            fp += all;
+        }
+    double theory = std::pow(1.0 - std::exp(-(double)k * (double)n / (double)m), (double)k);
+    return { P::name(), m, k, n, q, q > 0 ? (double)fp / (double)q : 0.0, theory, legacy };
+}
+
+int main(int argc, char** argv) {
+    const char* jsonPath = nullptr;
+    int sensors = 50, seqs = 100;
+    long queries = 200000;
+    bool check = false;
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--json") && i + 1 < argc) jsonPath = argv[++i];
+        else if (!std::strcmp(argv[i], "--sensors") && i + 1 < argc) sensors = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--seq") && i + 1 < argc) seqs = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--queries") && i + 1 < argc) queries = std::atol(argv[++i]);
+        else if (!std::strcmp(argv[i], "--check")) check = true;
+        else {
+            std::fprintf(stderr, "usage: %s [--json FILE] [--sensors N] [--seq N] [--queries N] [--check]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (sensors < 1) sensors = 1;
+    if (seqs < 1) seqs = 1;
+
+    std::vector<Result> results;
+    for (size_t m : {8192, 16384, 32768})
+        for (int k : {2, 3, 4}) {
+            results.push_back(run<LegacyProbes>(m, k, sensors, seqs, queries, true));
+            results.push_back(run<KmProbes<StdHashPolicy>>(m, k, sensors, seqs, queries, true));
+            results.push_back(run<KmProbes<SplitMixHashPolicy>>(m, k, sensors, seqs, queries, false));
+            results.push_back(run<KmProbes<Xxh3HashPolicy>>(m, k, sensors, seqs, queries, false));
+            results.push_back(run<KmProbes<WyHashPolicy>>(m, k, sensors, seqs, queries, false));
+        }
+
+    FILE* out = jsonPath ? std::fopen(jsonPath, "w") : stdout;
+    if (!out) { std::perror(jsonPath); return 1; }
+    std::fprintf(out, "{\n  \"id_scheme\": \"(index+1)*100000+seq\",\n  \"sensors\": %d,\n  \"seq\": %d,\n"
+                      "  \"default_hash\": \"%s\",\n  \"results\": [\n", sensors, seqs, DedupHash::name());
+    int bad = 0;
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        double ratio = r.fpTheory > 0 ? r.fpEmp / r.fpTheory : 0.0;
+        // 25% over theory, plus 4 binomial standard deviations
+        double sd = std::sqrt(r.fpTheory * (1.0 - r.fpTheory) / (double)std::max(1L, r.queries));
+        bool over = r.fpEmp > 1.25 * r.fpTheory + 4.0 * sd;
+        if (over && !r.legacy) bad++;
+        std::fprintf(out, "    {\"hash\": \"%s\", \"m\": %zu, \"k\": %d, \"n\": %ld, \"queries\": %ld, "
+                          "\"fp_empirical\": %.6f, \"fp_theory\": %.6f, \"ratio\": %.3f}%s\n",
+                     r.hash.c_str(), r.m, r.k, r.n, r.queries, r.fpEmp, r.fpTheory, ratio,
+                     i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(out, "  ]\n}\n");
+    if (out != stdout) std::fclose(out);
+    if (check && bad > 0) {
+        std::fprintf(stderr, "bloom_fp: %d policy/size combinations exceed the theoretical FP\n", bad);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,280 @@
+// /bench/crypto_bench.cc
+// Micro-benchmark for the src/crypto primitives used on the per-message path.
+// Reports ns/op, ops/s and heap allocations/op per primitive and batch size
+// as JSON, for calibrating costVerify_mJ and catching regressions.
+//
+//   crypto_bench [--json FILE] [--min-time SECONDS] [--batch 1,8,64] [--check]
+//
+// --check exits with status 1 if a steady-state verify path allocates on the
+// heap: stage_h_keycache and verify_batch_hmac replay the call sequence of
+// GatewayNode::stage_H (perSensorKeys) and GatewayNode::verifyBatchHmac; the
+// idts_* / keycache_verify rows cover the library entry points they use.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <string>
+#include <vector>
+#include "crypto/aes_backend.h"
+#include "crypto/cmac.h"
+#include "crypto/crypto_utils.h"
+#include "crypto/key_cache.h"
+
+// ===== heap allocation counter (global operator new)
+static long long g_allocs = 0;
+
+void* operator new(size_t n) {
+    ++g_allocs;
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t n) { return operator new(n); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+// keep a value alive without the optimiser removing the work
+template <class T>
+static inline void keep(const T& v) {
+    asm volatile("" : : "g"(&v) : "memory");
+}
+
+struct Result {
+    std::string name;
+    size_t batch;
+    double nsPerOp;
+    double allocsPerOp;
+};
+
+// Runs body() (which processes `batch` messages) until minTime has passed.
+static Result measure(const std::string& name, size_t batch, double minTime,
+                      const std::function<void()>& body) {
+    using clock = std::chrono::steady_clock;
+    body(); // warm-up
+
+    long long iters = 0;
+    long long allocs0 = g_allocs;
+    auto t0 = clock::now();
+    double elapsed = 0;
+    long long step = 1;
+    while (elapsed < minTime) {
+        for (long long i = 0; i < step; ++i) body();
+        iters += step;
+        elapsed = std::chrono::duration<double>(clock::now() - t0).count();
+        if (step < (1LL << 20)) step *= 2;
+    }
+    // read the counter before building Result: copying a long name allocates
+    long long allocs = g_allocs - allocs0;
+    double ops = (double)iters * (double)batch;
+    return { name, batch, elapsed * 1e9 / ops, (double)allocs / ops };
+}
+
+static std::vector<size_t> parseBatches(const char* s) {
+    std::vector<size_t> v;
+    while (*s) {
+        char* end = nullptr;
+        long n = std::strtol(s, &end, 10);
+        if (end == s) break;
+        if (n >= 1) v.push_back((size_t)std::min(n, 64L));
+        s = (*end == ',') ? end + 1 : end;
+    }
+    return v;
+}
+
+int main(int argc, char** argv) {
+    const char* jsonPath = nullptr;
+    double minTime = 0.2;
+    std::vector<size_t> batches = {1, 8, 16, 64};
+    bool check = false;
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--json") && i + 1 < argc) jsonPath = argv[++i];
+        else if (!std::strcmp(argv[i], "--min-time") && i + 1 < argc) minTime = std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "--batch") && i + 1 < argc) batches = parseBatches(argv[++i]);
+        else if (!std::strcmp(argv[i], "--check")) check = true;
+        else {
+            std::fprintf(stderr, "usage: %s [--json FILE] [--min-time SECONDS] [--batch 1,8,64] [--check]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (batches.empty()) batches = {1};
+
+    // same key and id/timestamp scheme as the simulation (SensorNode)
+    std::vector<uint8_t> key;
+    hexToBytes("00112233445566778899AABBCCDDEEFF", key);
+    CmacContext ctx(key.data());
+
+    const size_t maxBatch = *std::max_element(batches.begin(), batches.end());
+    std::vector<int> ids(maxBatch);
+    std::vector<int64_t> tss(maxBatch);
+    std::vector<std::array<uint8_t, 16>> tags(maxBatch);
+    std::vector<std::array<uint8_t, ID_TS_BYTES>> packed(maxBatch);
+    std::vector<std::string> hexTags(maxBatch);
+    for (size_t i = 0; i < maxBatch; ++i) {
+        ids[i] = (int)((i % 50) + 1) * 100000 + (int)(i / 50) + 1;
+        tss[i] = 500000 + 1000 * (int64_t)i;
+        packIdTsBigEndian(ids[i], tss[i], packed[i]);
+        cmacIdTs(ctx, ids[i], tss[i], tags[i].data());
+        hexTags[i] = bytesToHex(tags[i].data(), 16);
+    }
+    // per-sensor keys: cache large enough for every src, so after warm-up all lookups hit
+    CmacKeyCache keyCache;
+    keyCache.init(ctx, 64);
+    std::vector<std::array<uint8_t, 16>> srcTags(maxBatch);
+    for (size_t i = 0; i < maxBatch; ++i)
+        cmacIdTs(keyCache.get((int)(i % 50)), ids[i], tss[i], srcTags[i].data());
+
+    std::vector<Result> results;
+    for (size_t B : batches) {
+        results.push_back(measure("aes128_cmac", B, minTime, [&] {
+            for (size_t i = 0; i < B; ++i) {
+                uint8_t t[16];
+                aes128_cmac(key.data(), packed[i].data(), ID_TS_BYTES, t);
+                keep(t);
+            }
+        }));
+        results.push_back(measure("cmac_ctx_tag", B, minTime, [&] {
+            for (size_t i = 0; i < B; ++i) {
+                uint8_t t[16];
+                ctx.tag(packed[i].data(), ID_TS_BYTES, t);
+                keep(t);
+            }
+        }));
+        results.push_back(measure("idts_tag", B, minTime, [&] {
+            for (size_t i = 0; i < B; ++i) {
+                uint8_t t[16];
+                cmacIdTs(ctx, ids[i], tss[i], t);
+                keep(t);
+            }
+        }));
+        results.push_back(measure("idts_verify", B, minTime, [&] {
+            unsigned ok = 0;
+            for (size_t i = 0; i < B; ++i) ok += cmacIdTsVerify(ctx, ids[i], tss[i], tags[i].data(), 16);
+            keep(ok);
+        }));
+        results.push_back(measure("keycache_verify", B, minTime, [&] {
+            unsigned ok = 0;
+            for (size_t i = 0; i < B; ++i)
+                ok += cmacIdTsVerify(keyCache.get((int)(i % 50)), ids[i], tss[i], srcTags[i].data(), 16);
+            keep(ok);
+        }));
+        // GatewayNode::stage_H with perSensorKeys: tag length check, pack id||ts into
+        // a fixed array, key cache lookup by src, CMAC, constant-time compare
+        results.push_back(measure("stage_h_keycache", B, minTime, [&] {
+            unsigned ok = 0;
+            for (size_t i = 0; i < B; ++i) {
+                const size_t macLen = 16, tagBytes = 16;
+                if (macLen != tagBytes) continue;
+                uint8_t m[ID_TS_BYTES];
+                packIdTsBigEndian(ids[i], tss[i], m);
+                const CmacContext& k = keyCache.get((int)(i % 50));
+                uint8_t calc[16];
+                k.tag(m, ID_TS_BYTES, calc);
+                ok += ct_equal(calc, srcTags[i].data(), tagBytes);
+            }
+            keep(ok);
+        }));
+        // GatewayNode::flushBatch + verifyBatchHmac: per-batch result vector reused,
+        // stack buffers for the packed messages, one aes128_cmac_verify_batch per 64
+        std::vector<int8_t> batchHmacRes;
+        results.push_back(measure("verify_batch_hmac", B, minTime, [&] {
+            batchHmacRes.assign(B, -1);
+            uint8_t buf[64][ID_TS_BYTES];
+            CmacVerifyItem items[64];
+            size_t idx[64];
+            for (size_t base = 0; base < B; base += 64) {
+                size_t cnt = 0;
+                for (size_t i = base; i < B && i < base + 64; ++i) {
+                    packIdTsBigEndian(ids[i], tss[i], buf[cnt]);
+                    items[cnt] = { buf[cnt], ID_TS_BYTES, tags[i].data(), 16 };
+                    idx[cnt++] = i;
+                }
+                uint64_t pass = aes128_cmac_verify_batch(ctx, items, cnt);
+                for (size_t c = 0; c < cnt; ++c) batchHmacRes[idx[c]] = (int8_t)((pass >> c) & 1u);
+            }
+            keep(batchHmacRes[0]);
+        }));
+        results.push_back(measure("idts_verify_batch", B, minTime, [&] {
+            uint8_t m[64][ID_TS_BYTES];
+            CmacVerifyItem items[64];
+            for (size_t i = 0; i < B; ++i) {
+                packIdTsBigEndian(ids[i], tss[i], m[i]);
+                items[i] = { m[i], ID_TS_BYTES, tags[i].data(), 16 };
+            }
+            uint64_t pass = aes128_cmac_verify_batch(ctx, items, B);
+            keep(pass);
+        }));
+        results.push_back(measure("hexToBytes_vector", B, minTime, [&] {
+            for (size_t i = 0; i < B; ++i) {
+                std::vector<uint8_t> out;
+                hexToBytes(hexTags[i], out);
+                keep(out);
+            }
+        }));
+        results.push_back(measure("hexToBytes_array", B, minTime, [&] {
+            for (size_t i = 0; i < B; ++i) {
+                std::array<uint8_t, 16> out;
+                size_t n = 0;
+                hexToBytes(hexTags[i], out, n);
+                keep(out);
+            }
+        }));
+        results.push_back(measure("bytesToHex", B, minTime, [&] {
+            for (size_t i = 0; i < B; ++i) {
+                std::string h = bytesToHex(tags[i].data(), 16);
+                keep(h);
+            }
+        }));
+        results.push_back(measure("packIdTsBigEndian_vector", B, minTime, [&] {
+            for (size_t i = 0; i < B; ++i) {
+                std::vector<uint8_t> out;
+                packIdTsBigEndian(ids[i], tss[i], out);
+                keep(out);
+            }
+        }));
+        results.push_back(measure("packIdTsBigEndian_array", B, minTime, [&] {
+            for (size_t i = 0; i < B; ++i) {
+                std::array<uint8_t, ID_TS_BYTES> out;
+                packIdTsBigEndian(ids[i], tss[i], out);
+                keep(out);
+            }
+        }));
+        results.push_back(measure("ct_equal", B, minTime, [&] {
+            unsigned eq = 0;
+            for (size_t i = 0; i < B; ++i) eq += ct_equal(tags[i].data(), tags[(i + 1) % B].data(), 16);
+            keep(eq);
+        }));
+    }
+
+    FILE* out = jsonPath ? std::fopen(jsonPath, "w") : stdout;
+    if (!out) { std::perror(jsonPath); return 1; }
+    std::fprintf(out, "{\n  \"aes_backend\": \"%s\",\n  \"min_time_s\": %g,\n  \"results\": [\n",
+                 aes128_backend_name(), minTime);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        std::fprintf(out, "    {\"name\": \"%s\", \"batch\": %zu, \"ns_per_op\": %.2f, "
+                          "\"ops_per_s\": %.0f, \"allocs_per_op\": %.3f}%s\n",
+                     r.name.c_str(), r.batch, r.nsPerOp, 1e9 / r.nsPerOp, r.allocsPerOp,
+                     (i + 1 < results.size()) ? "," : "");
+    }
+    std::fprintf(out, "  ]\n}\n");
+    if (jsonPath) std::fclose(out);
+
+    if (check) {
+        int bad = 0;
+        for (const Result& r : results) {
+            if (r.name != "idts_verify" && r.name != "idts_verify_batch" && r.name != "keycache_verify" &&
+                r.name != "stage_h_keycache" && r.name != "verify_batch_hmac") continue;
+            if (r.allocsPerOp > 0) {
+                std::fprintf(stderr, "crypto_bench: %s (batch %zu) allocates %.3f times per op\n",
+                             r.name.c_str(), r.batch, r.allocsPerOp);
+                bad++;
+            }
+        }
+        if (bad > 0) return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,226 @@
+// /bench/crypto_kat.cc
+// Known-answer tests for src/crypto: AES-128 (FIPS-197), CMAC subkeys and tags
+// (RFC 4493 / SP 800-38B, 0, 16, 40 and 64 bytes) through aes128_cmac,
+// CmacContext and aes128_cmac_verify_batch, plus a cross-check of every AES
+// backend and of the batched CMAC against a byte-oriented tiny-AES reference.
+// Build once per backend (-DLIGHTIOT_AES_FORCE_*) so the library CMAC runs on
+// each of them; see bench/Makefile.
+//
+//   crypto_kat [--seed N]
+//
+// Exits with status 1 on any mismatch.
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include "crypto/aes_backend.h"
+#include "crypto/cmac.h"
+#include "crypto/crypto_utils.h"
+
+static int g_checks = 0;
+static int g_failures = 0;
+
+static void expect(bool ok, const char* what, size_t arg = 0) {
+    ++g_checks;
+    if (ok) return;
+    ++g_failures;
+    std::fprintf(stderr, "crypto_kat: FAIL %s (%zu)\n", what, arg);
+}
+
+static std::vector<uint8_t> hex(const char* s) {
+    std::vector<uint8_t> v;
+    if (!hexToBytes(s, v)) { std::fprintf(stderr, "crypto_kat: bad hex %s\n", s); std::exit(2); }
+    return v;
+}
+
+static bool same(const uint8_t* a, const std::vector<uint8_t>& b) {
+    return std::memcmp(a, b.data(), b.size()) == 0;
+}
+
+// ===== reference CMAC (SP 800-38B) on the tiny backend only
+static void dbl(const uint8_t in[16], uint8_t out[16]) {
+    uint8_t carry = in[0] >> 7;
+    for (int i = 0; i < 15; ++i) out[i] = (uint8_t)((in[i] << 1) | (in[i + 1] >> 7));
+    out[15] = (uint8_t)((in[15] << 1) ^ (carry ? 0x87 : 0x00));
+}
+
+static void refSubkeys(const uint8_t rk[176], uint8_t K1[16], uint8_t K2[16]) {
+    uint8_t L[16] = {0};
+    aes128_encrypt_block_tiny(rk, L);
+    dbl(L, K1);
+    dbl(K1, K2);
+}
+
+static void refCmac(const uint8_t key[16], const uint8_t* msg, size_t len, uint8_t out[16]) {
+    uint8_t rk[176], K1[16], K2[16];
+    aes128_expand_key(key, rk);
+    refSubkeys(rk, K1, K2);
+    size_t n = (len + 15) / 16;
+    bool complete = len > 0 && len % 16 == 0;
+    if (n == 0) n = 1;
+    uint8_t X[16] = {0};
+    for (size_t j = 0; j + 1 < n; ++j) {
+        for (int b = 0; b < 16; ++b) X[b] ^= msg[16*j + b];
+        aes128_encrypt_block_tiny(rk, X);
+    }
+    uint8_t last[16] = {0};
+    size_t rem = len - 16*(n - 1);
+    std::memcpy(last, msg + 16*(n - 1), rem);
+    if (!complete) last[rem] = 0x80;
+    for (int b = 0; b < 16; ++b) X[b] ^= last[b] ^ (complete ? K1[b] : K2[b]);
+    aes128_encrypt_block_tiny(rk, X);
+    std::memcpy(out, X, 16);
+}
+
+// ===== AES-128 block: FIPS-197 C.1 and A.1, every backend against tiny
+static void testAes(std::mt19937_64& rng) {
+    const std::vector<uint8_t> key = hex("000102030405060708090a0b0c0d0e0f");
+    const std::vector<uint8_t> pt  = hex("00112233445566778899aabbccddeeff");
+    const std::vector<uint8_t> ct  = hex("69c4e0d86a7b0430d8cdb78070b4c55a");
+    uint8_t rk[176];
+    aes128_expand_key(key.data(), rk);
+
+    // A.1: last round key of 2b7e1516...
+    uint8_t rkA[176];
+    aes128_expand_key(hex("2b7e151628aed2a6abf7158809cf4f3c").data(), rkA);
+    expect(same(rkA + 160, hex("d014f9a8c9ee2589e13f0cc8b6630ca6")), "key expansion round 10");
+
+    std::vector<Aes128EncryptFn> fns = { aes128_encrypt_block_tiny, aes128_encrypt_block_ttable,
+                                         aes128_encrypt_block };
+    std::vector<const char*> names = { "tiny", "ttable", "dispatch" };
+    const bool aesni = aes128_aesni_available();
+    if (aesni) { fns.push_back(aes128_encrypt_block_aesni); names.push_back("aesni"); }
+
+    for (size_t f = 0; f < fns.size(); ++f) {
+        uint8_t b[16];
+        std::memcpy(b, pt.data(), 16);
+        fns[f](rk, b);
+        expect(same(b, ct), names[f], 0);
+    }
+
+    // random keys/blocks: each backend equals tiny
+    for (int t = 0; t < 256; ++t) {
+        uint8_t k[16], r[176], ref[16], blk[16];
+        for (auto& x : k) x = (uint8_t)rng();
+        for (auto& x : ref) x = (uint8_t)rng();
+        aes128_expand_key(k, r);
+        std::memcpy(blk, ref, 16);
+        aes128_encrypt_block_tiny(r, ref);
+        for (size_t f = 1; f < fns.size(); ++f) {
+            uint8_t b[16];
+            std::memcpy(b, blk, 16);
+            fns[f](r, b);
+            expect(std::memcmp(b, ref, 16) == 0, names[f], (size_t)t);
+        }
+    }
+
+    // ECB batches: 1..20 blocks covers the 8-lane body and every tail length
+    for (size_t n = 1; n <= 20; ++n) {
+        std::vector<uint8_t> in(16*n), ref(16*n), got(16*n);
+        for (auto& x : in) x = (uint8_t)rng();
+        ref = in;
+        for (size_t i = 0; i < n; ++i) aes128_encrypt_block_tiny(rk, ref.data() + 16*i);
+        got = in;
+        aes128_encrypt_blocks(rk, got.data(), n);
+        expect(got == ref, "aes128_encrypt_blocks", n);
+        if (aesni) {
+            got = in;
+            aes128_encrypt_blocks_aesni(rk, got.data(), n);
+            expect(got == ref, "aes128_encrypt_blocks_aesni", n);
+        }
+    }
+}
+
+// ===== CMAC: RFC 4493 section 4 (key 2b7e1516..., M = 64 bytes of the SP 800-38A text)
+static void testCmac(std::mt19937_64& rng) {
+    const std::vector<uint8_t> key = hex("2b7e151628aed2a6abf7158809cf4f3c");
+    const std::vector<uint8_t> msg = hex(
+        "6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+        "30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710");
+    struct Vec { size_t len; const char* tag; };
+    const Vec vecs[] = {
+        { 0,  "bb1d6929e95937287fa37d129b756746" },
+        { 16, "070a16b46b4d4144f79bdd9dd04a287c" },
+        { 40, "dfa66747de9ae63030ca32611497c827" },
+        { 64, "51f0bebf7e3b9d92fc49741779363cfe" },
+    };
+
+    // subkeys (RFC 4493 4.: L, K1, K2); the library's K1/K2 are covered by the
+    // 16/64-byte (complete block, K1) and 0/40-byte (padded, K2) tags below
+    uint8_t rk[176], K1[16], K2[16], L[16] = {0};
+    aes128_expand_key(key.data(), rk);
+    aes128_encrypt_block_tiny(rk, L);
+    refSubkeys(rk, K1, K2);
+    expect(same(L, hex("7df76b0c1ab899b33e42f047b91b546f")), "subkey L");
+    expect(same(K1, hex("fbeed618357133667c85e08f7236a8de")), "subkey K1");
+    expect(same(K2, hex("f7ddac306ae266ccf90bc11ee46d513b")), "subkey K2");
+
+    CmacContext ctx(key.data());
+    CmacVerifyItem items[8];
+    std::vector<uint8_t> tags[4];
+    for (size_t v = 0; v < 4; ++v) {
+        tags[v] = hex(vecs[v].tag);
+        uint8_t t[16];
+        refCmac(key.data(), msg.data(), vecs[v].len, t);
+        expect(same(t, tags[v]), "reference cmac", vecs[v].len);
+        aes128_cmac(key.data(), msg.data(), vecs[v].len, t);
+        expect(same(t, tags[v]), "aes128_cmac", vecs[v].len);
+        ctx.tag(msg.data(), vecs[v].len, t);
+        expect(same(t, tags[v]), "CmacContext::tag", vecs[v].len);
+        expect(ctx.verify(msg.data(), vecs[v].len, tags[v].data(), 16), "CmacContext::verify", vecs[v].len);
+        t[15] ^= 1;
+        expect(!ctx.verify(msg.data(), vecs[v].len, t, 16), "CmacContext::verify rejects", vecs[v].len);
+        items[v] = { msg.data(), vecs[v].len, tags[v].data(), 16 };
+    }
+    // the same four with a flipped tag byte must fail
+    std::vector<uint8_t> bad[4];
+    for (size_t v = 0; v < 4; ++v) {
+        bad[v] = tags[v];
+        bad[v][v * 3] ^= 0x40;
+        items[4 + v] = { msg.data(), vecs[v].len, bad[v].data(), 16 };
+    }
+    expect(aes128_cmac_verify_batch(ctx, items, 8) == 0x0fULL, "verify_batch RFC 4493");
+
+    // batch vs reference: random lengths 0..80, truncated tags, every 5th forged, 1..64 items
+    for (size_t n = 1; n <= 64; n += (n < 10 ? 1 : 9)) {
+        std::vector<std::vector<uint8_t>> m(n), t(n);
+        std::vector<CmacVerifyItem> it(n);
+        uint64_t want = 0;
+        for (size_t i = 0; i < n; ++i) {
+            m[i].resize(rng() % 81);
+            for (auto& x : m[i]) x = (uint8_t)rng();
+            t[i].resize(16);
+            refCmac(key.data(), m[i].data(), m[i].size(), t[i].data());
+            size_t tagLen = (size_t)4 * (1 + rng() % 4);   // 4 | 8 | 12 | 16
+            if (i % 5 == 3) t[i][rng() % tagLen] ^= 0x01;
+            else want |= 1ULL << i;
+            it[i] = { m[i].data(), m[i].size(), t[i].data(), tagLen };
+        }
+        expect(aes128_cmac_verify_batch(ctx, it.data(), n) == want, "verify_batch vs reference", n);
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned long long seed = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--seed") && i + 1 < argc) seed = std::strtoull(argv[++i], nullptr, 10);
+        else {
+            std::fprintf(stderr, "usage: %s [--seed N]\n", argv[0]);
+            return 2;
+        }
+    }
+#if defined(LIGHTIOT_AES_FORCE_AESNI)
+    if (!aes128_aesni_available()) {
+        std::printf("crypto_kat: forced aesni but the CPU has no AES-NI, skipped\n");
+        return 0;
+    }
+#endif
+    std::mt19937_64 rng(seed);
+    testAes(rng);
+    testCmac(rng);
+    std::printf("crypto_kat: backend %s%s, %d checks, %d failures\n", aes128_backend_name(),
+                aes128_aesni_available() ? "" : " (no AES-NI: aesni skipped)", g_checks, g_failures);
+    return g_failures ? 1 : 0;
+}
@@ -235,7 +235,7 @@ if [[ $DO_BUILD -eq 1 ]]; then
   ensure_omnetpp_env
   echo "==> Building project"
   rm -rf out Makefile
-  opp_makemake -f --deep -o LightIoTSimulation -O out
+  opp_makemake -f --deep -o LightIoTSimulation -O out -X bench
   make -j"${JOBS}"
 else
   echo "==> Skipping build (use --build to enable)"
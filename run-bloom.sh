@@ -16,7 +16,7 @@ fi
 
 # Build
 rm -rf out Makefile
-opp_makemake -f --deep -o LightIoTSimulation -O out
+opp_makemake -f --deep -o LightIoTSimulation -O out -X bench
 make -j"$(nproc)"
 
 # Runs
@@ -88,7 +88,7 @@ if [[ $DO_BUILD -eq 1 ]]; then
   ensure_omnetpp_env
   echo "==> Building"
   rm -rf out Makefile
-  opp_makemake -f --deep -o LightIoTSimulation -O out
+  opp_makemake -f --deep -o LightIoTSimulation -O out -X bench
   make -j"$(nproc)"
 else
   # Still ensure runtime env for Qtenv
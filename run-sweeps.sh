@@ -60,7 +60,7 @@ CFG=(); expand "$SPEC" CFG
 [[ ${#CFG[@]} -gt 0 ]] || { echo "[ERR] No sweep configs"; exit 1; }
 
 if [[ $DO_BUILD -eq 1 ]]; then
-  ensure; echo "==> Building"; rm -rf out Makefile; opp_makemake -f --deep -o LightIoTSimulation -O out; make -j"$(nproc)"
+  ensure; echo "==> Building"; rm -rf out Makefile; opp_makemake -f --deep -o LightIoTSimulation -O out -X bench; make -j"$(nproc)"
 else
   [[ "$ENV_MODE" == "Qtenv" || -n "$OMNETPP_ROOT" ]] && ensure || true
 fi
@@ -22,7 +22,7 @@ ensure_build() {
   if [[ ! -x out/clang-release/LightIoTSimulation ]]; then
     echo "==> Building project..."
     rm -rf out Makefile
-    opp_makemake -f --deep -o LightIoTSimulation -O out -e cc
+    opp_makemake -f --deep -o LightIoTSimulation -O out -e cc -X bench
     make -j"$(nproc)"
   fi
 }
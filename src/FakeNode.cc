@@ -2,6 +2,8 @@
 #include <omnetpp.h>
 #include <cstring>
 #include <string>
+#include <vector>
+#include <array>
 #include "LightIoTMessage_m.h"
 #include "crypto/crypto_utils.h"
 #include "crypto/cmac.h"
@@ -16,12 +18,16 @@ class FakeNode : public cSimpleModule {
     int  attackMode = 1;                 // فعلاً فقط replay
     simtime_t replayInterval = 2.5;
 
-    int    replayId = 100000;
+    int    replayId = -1;                // -1 → (replaySensor+1)*idStrideFor(N) + replaySeq، مانند SensorNode
     long   replayTsUs = 500000;          // 0.5s
     std::string replayTagHex = "00000000000000000000000000000000";
+    std::array<uint8_t, LightIoTMessage::MAC_MAX> replayTag{}; // replayTagHex یک‌بار decode می‌شود
+    size_t replayTagLen = 0;
 
     bool validMac = false;
     std::string aesKeyHex;
+    CmacContext cmac;
+    int tagBytes = 16;                   // باید با Gateway یکی باشد
 
     int    dupBurstLen = 0;              // تعداد کپی اضافه
     simtime_t dupBurstGap = 1.0;
@@ -41,16 +47,11 @@ class FakeNode : public cSimpleModule {
         p->setTimestamp(SimTime((int64_t)replayTsUs, SIMTIME_US));
 
         if (validMac) {
-            std::vector<uint8_t> keyBytes;
-            if (!hexToBytes(aesKeyHex, keyBytes) || keyBytes.size()!=16)
-                keyBytes.assign(16, 0);
-            std::vector<uint8_t> mbytes;
-            packIdTsBigEndian(replayId, replayTsUs, mbytes);
             uint8_t tag[16];
-            aes128_cmac(keyBytes.data(), mbytes.data(), mbytes.size(), tag);
-            p->setMacHex(bytesToHex(tag, 16));
+            cmacIdTs(cmac, replayId, replayTsUs, tag);
+            p->setMac(tag, tagBytes);
         } else {
-            p->setMacHex(replayTagHex);
+            p->setMac(replayTag.data(), replayTagLen);
         }
         return p;
     }
@@ -62,11 +63,34 @@ class FakeNode : public cSimpleModule {
         replayInterval = par("replayInterval");
 
         replayId = par("replayId").intValue();
+        if (replayId < 0) {
+            // شناسهٔ یک بستهٔ واقعی سنسور: همان فاصلهٔ شناسه‌ها که SensorNode از numSensorNodes می‌گیرد
+            cModule* net = getParentModule();
+            int idStride = LightIoTMessage::idStrideFor(
+                (net && net->hasPar("numSensorNodes")) ? (int)net->par("numSensorNodes").intValue() : 0);
+            replayId = (par("replaySensor").intValue() + 1) * idStride + par("replaySeq").intValue();
+        }
         replayTsUs = par("replayTsUs").intValue();
         replayTagHex = par("replayTagHex").stdstringValue();
+        if (!hexToBytes(replayTagHex, replayTag, replayTagLen))
+            replayTagLen = 0; // نامعتبر → بدون تگ (در Gateway حذف می‌شود)
 
         validMac = par("validMac").boolValue();
         aesKeyHex = par("aesKeyHex").stdstringValue();
+        tagBytes = par("tagBytes").intValue();
+        if (!LightIoTMessage::isValidTagBytes(tagBytes)) tagBytes = 16;
+        if (validMac) {
+            std::vector<uint8_t> keyBytes;
+            if (!hexToBytes(aesKeyHex, keyBytes) || keyBytes.size()!=16)
+                keyBytes.assign(16, 0);
+            cmac.init(keyBytes.data());
+            if (par("perSensorKeys").boolValue()) {
+                // تگ معتبر برای src=-1 (بازپخش بستهٔ ضبط‌شده)
+                uint8_t k[16];
+                cmacDeriveSensorKey(cmac, -1, k);
+                cmac.init(k);
+            }
+        }
 
         dupBurstLen = par("dupBurstLen").intValue();
         dupBurstGap = par("dupBurstGap");
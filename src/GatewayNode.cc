@@ -3,16 +3,32 @@
 #include <omnetpp.h>
 #include <cstring>
 #include <set>
-#include <unordered_map>
+#include <deque>
 #include <vector>
 #include <string>
 #include <functional>
 #include <cstdint>
 #include <cmath>
+#include <cstdlib>
 #include <algorithm>
+#include <array>
+#include <chrono>
+#include <utility>
 #include "LightIoTMessage_m.h"
 #include "crypto/crypto_utils.h"
 #include "crypto/cmac.h"
+#include "crypto/aes_backend.h"
+#include "crypto/key_cache.h"
+#include "dedup/flat_id_set.h"
+#include "dedup/fp_oracle.h"
+#include "dedup/blocked_bloom.h"
+#include "dedup/cuckoo_filter.h"
+#include "dedup/aged_bloom.h"
+#include "dedup/packed_sbf.h"
+#include "dedup/hash_policy.h"
+#include "fresh/source_table.h"
+#include "fresh/replay_window.h"
+#include "net/shard_ring.h"
 using namespace omnetpp;
 
 class GatewayNode : public cSimpleModule {
@@ -22,42 +38,122 @@ class GatewayNode : public cSimpleModule {
     double battery     = 5000.0;
     double costForward = 5.0;
     double costVerify  = 5.0;
+    double costPrecheck = 0.0;    // هزینهٔ هر اجرای مرحلهٔ P (فقط مدل stage)
+    double energyP = 0.0;
+    // مدل انرژی بررسی: flat = costVerify برای هر پیام (سازگاری)، stage = هزینهٔ هر مرحله فقط وقتی اجرا شود
+    bool stageEnergy = false;
+    double costH = 3.5;
+    double costF = 0.5;
+    double costB = 1.0;           // بسته به روش Duplicate (costBMethod_mJ) مگر costB_mJ >= 0
+    double energyH = 0.0, energyF = 0.0, energyB = 0.0;
+    double energyVerifyFlat = 0.0;
+    double rxCostPerByte = 0.0;   // هزینه دریافت رادیویی به ازای هر بایت
+    double txCostPerByte = 0.0;   // هزینه ارسال به Cloud به ازای هر بایت
 
     // ===== کلید و امنیت
     std::string aesKeyHex;
     std::vector<uint8_t> keyBytes;
+    CmacContext cmac;           // key schedule + K1/K2 یک‌بار در initialize
+    // کلید جدا برای هر سنسور (KDF از کلید اصلی) + کش محدود کانتکست‌ها
+    bool perSensorKeys = false;
+    int  keyCacheSize  = 1024;
+    CmacKeyCache keyCache;
     bool securityEnabled = true;
     bool checkHmac       = true;
     bool checkFreshness  = true;
     bool checkDuplicate  = true;
+    int  tagBytes        = 16;     // طول تگ کوتاه‌شده (4/8/12/16)
 
     // ترتیب مراحل
     std::string stageOrder = "HFB";
-    int orderId = 1; // HFB=1, HBF=2, FHB=3, FBH=4, BHF=5, BFH=6, else 0
+    int orderId = 1; // HFB=1, HBF=2, FHB=3, FBH=4, BHF=5, BFH=6, 7..30 با P (ORDERS)، else 0
+    simtime_t precheckFutureSkew = 0.01;   // حداکثر جلو بودن timestamp نسبت به simTime
 
     simtime_t hmacWindow = 1;   // s
     simtime_t procDelay  = 0;   // s
 
+    // ===== micro-batching: صف تا batchSize پیام یا انقضای batchTimeout، سپس اجرای خط لوله برای همه
+    int batchSize = 1;                  // 1 → خاموش (پردازش تک‌پیامی)
+    simtime_t batchTimeout = 0.01;      // s، از ورود اولین پیام دسته
+    double batchCostFixed  = 0.0;       // انرژی ثابت هر دسته (بیدار شدن، key schedule، ...)
+    double batchCostPerMsg = 5.0;       // انرژی هر پیام دسته؛ جایگزین costVerify
+    std::vector<LightIoTMessage*> batch;
+    std::vector<int8_t> batchHmacRes;   // نتیجهٔ CMAC دسته‌ای هر پیام: -1 ندارد، 0/1
+    int batchHmac = -1;                 // همان برای پیامی که اکنون در خط لوله است
+    cMessage* batchTimer = nullptr;
+    long batches = 0;
+    long batchTimeoutFlushes = 0;
+    long batchMessages = 0;
+    double batchWaitSum = 0.0;
+    double batchWaitMax = 0.0;
+    double batchEnergy = 0.0;
+    simtime_t lastFlush = 0;
+    cOutVector batchSizeVec;         // اندازهٔ هر دسته
+    cOutVector batchWaitVec;         // تأخیر صف افزوده برای هر پیام (s)
+    cOutVector batchThroughputVec;   // پیام بر ثانیه بین دو دستهٔ متوالی
+
+    // ===== مدل صف: verifierCores سرویس‌دهندهٔ موازی + بافر محدود
+    // زمان سرویس = procDelay + زمان مراحلی که واقعاً اجرا شدند (P/H/F/B)
+    int verifierCores = 0;              // 0 → خاموش (ظرفیت نامحدود، procDelay ثابت)
+    int bufferSize = 64;                // پیام‌های منتظر (بدون پیام‌های در حال سرویس)
+    bool queueDropOldest = false;       // droptail | dropoldest
+    simtime_t serviceTimeP = 2e-6;
+    simtime_t serviceTimeH = 100e-6;
+    simtime_t serviceTimeF = 10e-6;
+    simtime_t serviceTimeB = 20e-6;
+    std::deque<LightIoTMessage*> waitQueue;
+    std::vector<cMessage*> coreTimers;  // یک رویداد پایان سرویس برای هر هسته؛ context = پیام پذیرفته‌شده
+    std::vector<cMessage*> freeCores;
+    simtime_t lastQueueChange = 0;
+    double queueArea = 0.0;             // ∫ طول صف dt
+    double busyArea = 0.0;              // ∫ هسته‌های مشغول dt
+    size_t queueLenMax = 0;
+    long served = 0;
+    double serviceSum = 0.0;
+    double queueWaitSum = 0.0;
+    double queueWaitMax = 0.0;
+    double pendingForward = 0.0;     // انرژی رزروشده: فوروارد پیام‌های در حال سرویس، بررسی+فوروارد پیام‌های دسته
+    cOutVector queueLenVec;          // طول صف پس از هر تغییر
+    cOutVector queueWaitVec;         // انتظار هر پیام در صف (s)
+
     // ===== شمارنده‌ها
     int inReceived = 0;
     int totalAccepted = 0;
     int totalDroppedHmac = 0;
+    int totalDroppedPrecheck = 0;
     int totalDroppedReplay = 0;
     int totalDroppedDup = 0;
+    int totalDroppedQueue = 0;   // بافر پر (مدل صف)
+    int totalDroppedDedupFull = 0; // ثبت در flatset ناموفق (جدول پر)؛ تکراری نبوده است
+    int totalDroppedBattery = 0; // باتری ناکافی در شروع سرویس (مدل صف) یا هنگام flush دسته
     int mismatchCounter = 0;
+    long rxBytes = 0;
+    long txBytes = 0;
 
-    // ===== تازگی: ماسک 64 بیتی per-sensor (seq-based)
+    // ===== تازگی: ماسک 64 بیتی per-sensor (seq-based)؛ پنجرهٔ بزرگ‌تر → بیت‌مپ حلقوی
     struct FreshState {
         uint64_t maxSeq = 0;
         uint64_t mask   = 0;
         simtime_t lastTs = 0;
         double avgPeriod = 1.0; // برآورد دوره ارسال
         int Wmsgs = 64;
+        ReplayRing ring;        // فقط وقتی replayWindow > 64 (تخصیص در اولین پیام)
     };
-    std::unordered_map<int, FreshState> freshMap; // key = src
+    int replayWindow = 64;      // حداکثر Wmsgs؛ 64 = مسیر سریع تک‌کلمه‌ای
+    // src در [0, numSensors) → آرایهٔ پیوسته؛ بقیه → جدول سرریز محدود (CLOCK)
+    int numSensors = -1;              // -1 → numSensorNodes شبکهٔ والد
+    int idStride = LightIoTMessage::ID_STRIDE;   // مانند SensorNode: idStrideFor(numSensors)
+    int freshOverflowSize = 64;
+    std::string freshOverflowPolicy = "evict";   // evict | drop
+    SourceTable<FreshState> freshTable;
+    // چند Gateway: gatewayShard[k] فقط سنسورهایی را که حلقهٔ consistent hashing به او داده نگه می‌دارد
+    int numGateways = 1;
+    int shardIndex = -1;              // -1 → Gateway تنها
+    int shardSensors = 0;             // سنسورهای این شارد (= numSensors برای Gateway تنها)
 
-    // ===== Duplicate ground truth برای FP
-    std::set<int> truthSeenIds;
+    // ===== Duplicate ground truth برای FP (off | full | sampled:p)
+    std::string fpOracleSpec = "full";
+    FpOracle oracle;
 
     // ===== روش حذف تکرار
     std::string duplicateMethod = "set";
@@ -65,27 +161,48 @@ class GatewayNode : public cSimpleModule {
     // set
     std::set<int> seenIds;
 
+    // flatset: جدول open-addressing با ظرفیت ثابت و حذف بر اساس زمان
+    int flatsetCapacity = 16384;
+    simtime_t flatsetRetention = 0;   // 0 → hmacWindow
+    FlatIdSet flatSet;
+
+    // cuckoo: fingerprint + epoch، حذف صریح IDهای خارج از پنجرهٔ تازگی
+    int cuckooCapacity   = 16384;
+    int cuckooFpBits     = 12;
+    int cuckooBucketSize = 4;
+    int cuckooMaxKicks   = 500;
+    simtime_t cuckooRetention = 0;    // 0 → hmacWindow
+    CuckooFilter cuckoo;
+
     // Bloom
     int bloomBits = 16384;
     int bloomHashes = 3;
     std::vector<uint8_t> bloomBitsArr;
 
-    // SBF
+    // blocked_bloom: همان bloomBits/bloomHashes، همهٔ k بیت در یک بلوک 64 بایتی
+    BlockedBloom blockedBloom;
+
+    // aged_bloom: G نسل، هر نسل hmacWindow/G از زمان شبیه‌سازی؛ bloomBits کل حافظه است
+    int agedBloomGenerations = 4;
+    AgedBloom agedBloom;
+
+    // SBF: شمارنده‌های 4 بیتی فشرده (16 عدد در هر کلمهٔ 64 بیتی)؛ sbfBits = حافظهٔ واقعی
     int sbfBits = 16384;
     int sbfHashes = 3;
     double sbfDecay = 0.02;
-    std::vector<uint8_t> sbfCounters; // 4-bit style (0..15), stored in bytes for سادگی
+    simtime_t sbfDecayPeriod = 0;     // 0 → کاهش به ازای هر درج (sbfDecay)؛ وگرنه یک دور کامل در هر دوره
+    PackedSbf sbf;
 
     // آمار Bloom/SBF
     long bloomQueries = 0;
     long bloomInserts = 0;
-    long bloomFalsePos = 0;
 
     // بردارهای زمانی
     cOutVector bloomCallsVec;    // q_bloom_calls
     cOutVector bloomInsertsVec;  // q_bloom_inserts
 
     // ===== شمارنده‌های «کار» (برای Workavg)
+    long workP_checks = 0;   // تعداد دفعات اجرای مرحله P (پیش‌فیلتر ساختاری)
     long workH_checks = 0;   // تعداد دفعات اجرای مرحله H
     long workF_checks = 0;   // تعداد دفعات اجرای مرحله F
     long workB_checks = 0;   // تعداد دفعات اجرای مرحله Duplicate (B)
@@ -95,14 +212,12 @@ class GatewayNode : public cSimpleModule {
         int bytes = (bits + 7) / 8;
         bloomBitsArr.assign(bytes, 0u);
     }
-    inline size_t hashMix(uint64_t x, uint64_t seed) const {
-        return std::hash<uint64_t>{}(x ^ (seed * 0x9e3779b97f4a7c15ULL));
-    }
+    // k اندیس از یک hash (DedupHash + Kirsch–Mitzenmacher، hash_policy.h)
     inline bool bloomTest_id(int id) const {
         if (bloomBitsArr.empty()) return false;
+        KmIndex<> km(id);
         for (int k = 0; k < bloomHashes; ++k) {
-            size_t h = hashMix((uint64_t)id, (uint64_t)k);
-            size_t bit = h % (size_t)bloomBits;
+            size_t bit = km.mod(k, (size_t)bloomBits);
             if ((bloomBitsArr[bit >> 3] & (uint8_t)(1u << (bit & 7))) == 0)
                 return false;
         }
@@ -110,77 +225,125 @@ class GatewayNode : public cSimpleModule {
     }
     inline void bloomAdd_id(int id) {
         if (bloomBitsArr.empty()) return;
+        KmIndex<> km(id);
         for (int k = 0; k < bloomHashes; ++k) {
-            size_t h = hashMix((uint64_t)id, (uint64_t)k);
-            size_t bit = h % (size_t)bloomBits;
+            size_t bit = km.mod(k, (size_t)bloomBits);
             bloomBitsArr[bit >> 3] |= (uint8_t)(1u << (bit & 7));
         }
     }
 
-    inline void sbfInit(int counters) {
-        sbfCounters.assign(counters, 0u);
-    }
-    inline bool sbfTest_id(int id) const {
-        if (sbfCounters.empty()) return false;
-        for (int k = 0; k < sbfHashes; ++k) {
-            size_t h = hashMix((uint64_t)id, (uint64_t)k + 1337);
-            size_t idx = h % (size_t)sbfCounters.size();
-            if (sbfCounters[idx] == 0) return false;
-        }
-        return true;
-    }
-    inline void sbfAgeOnce() {
-        if (sbfCounters.empty()) return;
-        size_t idx = (size_t) intrand((int)sbfCounters.size());
-        if (sbfCounters[idx] > 0) sbfCounters[idx]--;
+    inline bool sbfTest_id(int id) {
+        sbf.tick(ts_to_us(simTime()));
+        return sbf.test(id);
     }
     inline void sbfAdd_id(int id) {
-        // aging تقریبی: به نسبت sbfDecay
-        int ageCount = std::max(1, (int)std::round(sbfDecay * (double)std::max(1, sbfHashes)));
-        for (int i=0;i<ageCount;i++) sbfAgeOnce();
-        for (int k = 0; k < sbfHashes; ++k) {
-            size_t h = hashMix((uint64_t)id, (uint64_t)k + 1337);
-            size_t idx = h % (size_t)sbfCounters.size();
-            if (sbfCounters[idx] < 15) sbfCounters[idx]++;
+        if (sbfDecayPeriod > SIMTIME_ZERO) {
+            sbf.tick(ts_to_us(simTime()));
+        } else {
+            // aging تقریبی: به نسبت sbfDecay، روی بازهٔ پیوسته از مکان نما (بدون RNG)
+            int ageCount = std::max(1, (int)std::round(sbfDecay * (double)std::max(1, sbfHashes)));
+            sbf.decay((size_t)ageCount);
         }
+        sbf.add(id);
     }
 
     inline int64_t ts_to_us(simtime_t t) const {
         return (int64_t) llround(SIMTIME_DBL(t) * 1e6);
     }
 
+    // شناسهٔ ترتیب‌ها: 1..6 = جایگشت‌های HFB (مانند قبل)، 7..30 = همان‌ها با P در هر یک از 4 جایگاه
+    // (id = 6 + 4*(base-1) + pos + 1)؛ اندیس 0 = پیش‌فرض HFB
+    static const int NUM_ORDERS = 30;
+    static constexpr char ORDERS[NUM_ORDERS + 1][5] = {
+        "HFB",
+        "HFB", "HBF", "FHB", "FBH", "BHF", "BFH",
+        "PHFB", "HPFB", "HFPB", "HFBP",   "PHBF", "HPBF", "HBPF", "HBFP",
+        "PFHB", "FPHB", "FHPB", "FHBP",   "PFBH", "FPBH", "FBPH", "FBHP",
+        "PBHF", "BPHF", "BHPF", "BHFP",   "PBFH", "BPFH", "BFPH", "BFHP" };
+
+    static const char* orderName(int id){
+        return (id >= 1 && id <= NUM_ORDERS) ? ORDERS[id] : ORDERS[0];
+    }
     static int orderIdFromStr(const std::string& s){
-        if (s=="HFB") return 1;
-        if (s=="HBF") return 2;
-        if (s=="FHB") return 3;
-        if (s=="FBH") return 4;
-        if (s=="BHF") return 5;
-        if (s=="BFH") return 6;
+        for (int id = 1; id <= NUM_ORDERS; ++id) if (s == ORDERS[id]) return id;
         return 0;
     }
     static std::string normalizeOrder(std::string s){
-        // upper + keep only H/F/B; map 'D'->'B'
+        // upper + keep only H/F/B/P; map 'D'->'B'
         for (char& c: s){ c = (char)toupper((unsigned char)c); if (c=='D') c='B'; }
         std::string t;
-        for (char c: s){ if (c=='H'||c=='F'||c=='B') if (t.find(c)==std::string::npos) t.push_back(c); }
-        // append missing to reach length 3, default order HFB
+        for (char c: s){ if (c=='H'||c=='F'||c=='B'||c=='P') if (t.find(c)==std::string::npos) t.push_back(c); }
+        // append missing to reach H/F/B (P اختیاری است), default order HFB
         for (char c: std::string("HFB")) if (t.find(c)==std::string::npos) t.push_back(c);
-        if (t.size()!=3) t="HFB";
+        if (t.size()!=3 && t.size()!=4) t="HFB";
         return t;
     }
 
+    // ===== انرژی بررسی
+    inline void chargeStage(double cost, double& total){
+        if (!stageEnergy) return;
+        battery -= cost;
+        total += cost;
+    }
+    inline void chargeFlatVerify(double cost){
+        if (stageEnergy) return;
+        battery -= cost;
+        energyVerifyFlat += cost;
+    }
+    // هزینهٔ B برای یک روش از رشتهٔ "set:1.2 bloom:0.8 ..."؛ false اگر روش در آن نباشد
+    static bool methodCostFromSpec(const std::string& spec, const std::string& method, double& out){
+        size_t i = 0;
+        while (i < spec.size()) {
+            size_t j = spec.find_first_of(" ,;", i);
+            if (j == std::string::npos) j = spec.size();
+            std::string tok = spec.substr(i, j - i);
+            size_t c = tok.find(':');
+            if (c != std::string::npos && tok.substr(0, c) == method) {
+                char* end = nullptr;
+                double v = std::strtod(tok.c_str() + c + 1, &end);
+                if (end && *end == '\0' && v >= 0) { out = v; return true; }
+                return false;
+            }
+            i = j + 1;
+        }
+        return false;
+    }
+    // حداکثر انرژی بررسی یک پیام (برای کنترل باتری پیش از پذیرش)
+    double verifyReserve() const {
+        return stageEnergy ? (stageOrder.find('P') != std::string::npos ? costPrecheck : 0.0) +
+                             (checkHmac ? costH : 0.0) + (checkFreshness ? costF : 0.0) + (checkDuplicate ? costB : 0.0)
+                           : costVerify;
+    }
+
     // ===== مراحل به‌صورت توابع
+    // P: پیش‌فیلتر ساختاری، چند عمل صحیح پیش از هر رمزنگاری
+    bool precheckOk(const LightIoTMessage* m) const {
+        const int src = m->getSrc(), seq = m->getSeq();
+        // محدودهٔ src پیش از محاسبهٔ id؛ حاصل‌ضرب در int64 (بدون سرریز برای src دلخواه)
+        return src >= 0 && (numSensors <= 0 || src < numSensors) &&         // محدودهٔ سنسورها
+               (shardIndex < 0 || freshTable.hasDense(src)) &&               // سنسور این شارد
+               seq >= 1 && seq < idStride &&
+               (int64_t)m->getId() == ((int64_t)src + 1) * idStride + seq &&  // سازگاری id/src/seq
+               m->getTimestamp() <= simTime() + precheckFutureSkew;         // timestamp آینده
+    }
+    bool stage_P(LightIoTMessage* m){
+        workP_checks++;
+        chargeStage(costPrecheck, energyP);
+        bool ok = precheckOk(m);
+        if (!ok) totalDroppedPrecheck++;
+        return ok;
+    }
+
     bool stage_H(LightIoTMessage* m){
         if (!checkHmac) return true;
         workH_checks++;
-        const std::string rxHex = m->getMacHex();
-        if (rxHex.empty()) { totalDroppedHmac++; return false; }
-
-        std::vector<uint8_t> msgbytes; packIdTsBigEndian(m->getId(), ts_to_us(m->getTimestamp()), msgbytes);
-        uint8_t tag[16]; aes128_cmac(keyBytes.data(), msgbytes.data(), msgbytes.size(), tag);
-
-        std::vector<uint8_t> rx;
-        bool ok = hexToBytes(rxHex, rx) && rx.size()==16 && ct_equal(rx.data(), tag, 16);
+        chargeStage(costH, energyH);
+        // بدون تخصیص heap: تگ باینری پیام + بافر 12 بایتی روی stack
+        // مقایسهٔ ثابت‌زمان روی tagBytes بایت اول CMAC
+        // در حالت دسته‌ای نتیجه پیش‌تر با aes128_cmac_verify_batch محاسبه شده است
+        bool ok = batchHmac >= 0 ? batchHmac == 1 :
+                  m->getMacLen()==(size_t)tagBytes &&
+                  cmacIdTsVerify(perSensorKeys ? keyCache.get(m->getSrc()) : cmac, m->getId(), ts_to_us(m->getTimestamp()), m->getMac(), tagBytes);
         if (!ok) { totalDroppedHmac++; }
         return ok;
     }
@@ -188,21 +351,39 @@ class GatewayNode : public cSimpleModule {
     bool stage_F(LightIoTMessage* m){
         if (!checkFreshness) return true;
         workF_checks++;
+        chargeStage(costF, energyF);
         int src = m->getSrc();
         int s   = m->getSeq();
-        auto &fs = freshMap[src];
+        FreshState* fsp = freshTable.find(src);
+        if (!fsp) { totalDroppedReplay++; return false; }   // جدول سرریز پر (drop)
+        auto &fs = *fsp;
 
+        // زمان ورود (نه simTime): در حالت دسته‌ای پیام‌ها با تأخیر پردازش می‌شوند
+        const simtime_t arrival = m->getArrivalTime();
         if (fs.lastTs > SIMTIME_ZERO) {
-            double per = SIMTIME_DBL(simTime() - fs.lastTs);
+            double per = SIMTIME_DBL(arrival - fs.lastTs);
             if (per > 1e-9) fs.avgPeriod = 0.9*fs.avgPeriod + 0.1*per;
         }
-        fs.lastTs = simTime();
+        fs.lastTs = arrival;
 
         int Wmsgs = (int) std::ceil(std::max(1e-9, SIMTIME_DBL(hmacWindow)) / std::max(1e-9, fs.avgPeriod));
-        fs.Wmsgs = std::min(64, std::max(1, Wmsgs));
+        fs.Wmsgs = std::min(replayWindow, std::max(1, Wmsgs));
 
         bool freshOk = true;
-        if ((uint64_t)s > fs.maxSeq) {
+        if (replayWindow > 64) {
+            if (fs.ring.empty()) fs.ring.init((size_t)replayWindow);
+            if ((uint64_t)s > fs.maxSeq) {
+                fs.ring.advance(fs.maxSeq, (uint64_t)s);   // فقط کلمه‌های عبورشده پاک می‌شوند
+                fs.ring.set((uint64_t)s);
+                fs.maxSeq = (uint64_t)s;
+            } else if ((int64_t)(fs.maxSeq - (uint64_t)s) >= fs.Wmsgs) {
+                freshOk = false; // خارج از پنجره → replay
+            } else if (fs.ring.test((uint64_t)s)) {
+                freshOk = false; // تکرار در پنجره
+            } else {
+                fs.ring.set((uint64_t)s);
+            }
+        } else if ((uint64_t)s > fs.maxSeq) {
             uint64_t shift = (uint64_t)s - fs.maxSeq;
             if (shift >= 64) fs.mask = 0;
             else fs.mask <<= shift;
@@ -222,32 +403,303 @@ class GatewayNode : public cSimpleModule {
         return freshOk;
     }
 
-    bool stage_B(LightIoTMessage* m){
-        if (!checkDuplicate) return true;
-        workB_checks++;
+    // حکم F بدون تغییر وضعیت (برای نمونه‌برداری ترتیب تطبیقی)؛ Wmsgs همان مقدار آخرین پیام منبع است.
+    // منبع جدید همیشه تازه است (حذف منبع جدید در سیاست drop با جدول سرریز پر در نظر گرفته نمی‌شود)
+    bool freshPeek(const LightIoTMessage* m) const {
+        const FreshState* fs = freshTable.peek(m->getSrc());
+        if (!fs) return true;
+        const uint64_t s = (uint64_t)m->getSeq();
+        if ((int64_t)s > (int64_t)fs->maxSeq) return true;
+        const uint64_t delta = fs->maxSeq - s;
+        if ((int64_t)delta >= std::max(1, fs->Wmsgs)) return false;
+        if (replayWindow > 64) return fs->ring.empty() || !fs->ring.test(s);
+        return !(fs->mask & (1ULL << delta));
+    }
 
-        int id = m->getId();
-        bool passDup = true;
+    // ===== Duplicate: یک پیاده‌سازی به ازای هر روش (انتخاب در زمان کامپایل)
+    enum DupMethod { DUP_SET, DUP_FLATSET, DUP_BLOOM, DUP_BLOCKED_BLOOM, DUP_AGED_BLOOM, DUP_CUCKOO, DUP_SBF, DUP_COUNT };
+    DupMethod dupMethod = DUP_SET;
 
-        if (duplicateMethod == "set") {
+    static DupMethod dupMethodFromStr(const std::string& s){
+        if (s=="flatset")       return DUP_FLATSET;
+        if (s=="bloom")         return DUP_BLOOM;
+        if (s=="blocked_bloom") return DUP_BLOCKED_BLOOM;
+        if (s=="aged_bloom")    return DUP_AGED_BLOOM;
+        if (s=="cuckoo")        return DUP_CUCKOO;
+        if (s=="sbf")           return DUP_SBF;
+        return DUP_SET;
+    }
+
+    // true = «قبلاً دیده شده» (احتمالی برای روش‌های تقریبی)
+    template <DupMethod D>
+    bool dupSeen(int id){
+        if constexpr (D == DUP_SET) {
             // «پرس‌وجو» را هم به‌عنوان کار می‌شماریم
-            if (seenIds.find(id) != seenIds.end()) passDup = false;
-        } else if (duplicateMethod == "bloom") {
-            bloomQueries++; bloomCallsVec.record(1);
-            bool maybe = bloomTest_id(id);
-            if (maybe && truthSeenIds.find(id) == truthSeenIds.end()) bloomFalsePos++;
-            if (maybe) passDup = false;
-        } else { // sbf
-            bloomQueries++; bloomCallsVec.record(1);
-            bool maybe = sbfTest_id(id);
-            if (maybe && truthSeenIds.find(id) == truthSeenIds.end()) bloomFalsePos++;
-            if (maybe) passDup = false;
+            return seenIds.find(id) != seenIds.end();
+        } else if constexpr (D == DUP_FLATSET) {
+            return flatSet.contains(id, ts_to_us(simTime()));
+        } else {
+            bool maybe;
+            if constexpr (D == DUP_CUCKOO) {
+                maybe = cuckoo.contains(id, ts_to_us(simTime()));
+            } else {
+                bloomQueries++; bloomCallsVec.record(1);
+                if constexpr (D == DUP_BLOOM)              maybe = bloomTest_id(id);
+                else if constexpr (D == DUP_BLOCKED_BLOOM) maybe = blockedBloom.test(id);
+                else if constexpr (D == DUP_AGED_BLOOM)    maybe = agedBloom.test(id, ts_to_us(simTime()));
+                else                                       maybe = sbfTest_id(id);
+            }
+            oracle.recordQuery(id, maybe);
+            return maybe;
         }
+    }
+
+    // همان dupSeen بدون oracle و شمارنده‌های bloom (نمونه‌برداری ترتیب تطبیقی)
+    bool dupPeek(int id){
+        const int64_t now = ts_to_us(simTime());
+        switch (dupMethod) {
+            case DUP_SET:           return seenIds.find(id) != seenIds.end();
+            case DUP_FLATSET:       return flatSet.contains(id, now);
+            case DUP_BLOOM:         return bloomTest_id(id);
+            case DUP_BLOCKED_BLOOM: return blockedBloom.test(id);
+            case DUP_AGED_BLOOM:    return agedBloom.test(id, now);
+            case DUP_CUCKOO:        return cuckoo.contains(id, now);
+            default:                return sbf.test(id);
+        }
+    }
 
+    // ثبت پیام پذیرفته‌شده برای دفعات بعد؛ false = ID ثبت نشد (flatset پر، حتی پس از حذف منقضی‌ها)
+    template <DupMethod D>
+    bool dupInsert(int id){
+        if constexpr (D == DUP_SET) {
+            seenIds.insert(id);
+        } else if constexpr (D == DUP_FLATSET) {
+            return flatSet.insert(id, ts_to_us(simTime()));
+        } else if constexpr (D == DUP_CUCKOO) {
+            cuckoo.insert(id, ts_to_us(simTime()));
+        } else {
+            bloomInserts++; bloomInsertsVec.record(1);
+            if constexpr (D == DUP_BLOOM)              bloomAdd_id(id);
+            else if constexpr (D == DUP_BLOCKED_BLOOM) blockedBloom.add(id);
+            else if constexpr (D == DUP_AGED_BLOOM)    agedBloom.add(id, ts_to_us(simTime()));
+            else                                       sbfAdd_id(id);
+        }
+        return true;
+    }
+
+    template <DupMethod D>
+    bool stage_B(LightIoTMessage* m){
+        if (!checkDuplicate) return true;
+        workB_checks++;
+        chargeStage(costB, energyB);
+        bool passDup = !dupSeen<D>(m->getId());
         if (!passDup) totalDroppedDup++;
         return passDup;
     }
 
+    // ===== ترتیب تطبیقی: احتمال رد و هزینهٔ هر مرحله روی پنجرهٔ لغزان
+    struct StageWindow {
+        std::vector<uint8_t> rej;   // حلقهٔ آخرین نتایج (1 = رد)
+        std::vector<float>   cost;  // حلقهٔ هزینهٔ اندازه‌گیری‌شده (ns)
+        size_t pos = 0, n = 0;
+        long rejSum = 0;
+        double costSum = 0;
+        void init(size_t w){ rej.assign(w, 0); cost.assign(w, 0.f); pos = n = 0; rejSum = 0; costSum = 0; }
+        void add(bool rejected, double c){
+            if (n == rej.size()) { rejSum -= rej[pos]; costSum -= cost[pos]; } else n++;
+            rej[pos] = rejected ? 1 : 0; cost[pos] = (float)c;
+            rejSum += rej[pos]; costSum += cost[pos];
+            pos = (pos + 1) % rej.size();
+        }
+        double rejectRate() const { return n ? (double)rejSum / (double)n : 0.0; }
+        double avgCost() const { return n ? costSum / (double)n : 0.0; }
+    };
+    bool adaptiveOrder = false;
+    bool adaptiveMeasured = false;    // هزینه از ساعت دیواری (غیرقطعی) به‌جای مدل
+    int adaptiveWindow = 1000;        // پیام در پنجرهٔ لغزان هر مرحله
+    int adaptiveInterval = 200;       // هر چند پیام یک‌بار ترتیب بازبینی شود
+    double adaptiveHysteresis = 0.1;  // حداقل بهبود نسبی برای تعویض
+    double adaptiveCost[4] = {45.0, 5.0, 10.0, 2.0};   // مدل هزینه H/F/B/P (ns به ازای اجرا)
+    StageWindow stageWin[4];          // H, F, B, P
+    // نرخ‌های stageWin شرطی‌اند (فقط بازماندگان مراحل قبلی در ترتیب فعلی).
+    // روی کسری از پیام‌ها همهٔ مراحل بدون اثر جانبی ارزیابی می‌شوند و الگوی مشترک رد (4 بیت) ثبت می‌شود
+    double adaptiveSampleRate = 0.05;
+    uint64_t adaptiveSampleThreshold = 0;
+    uint64_t adaptiveSampleCounter = 0;
+    std::vector<uint8_t> jointRing;   // حلقهٔ آخرین الگوهای رد نمونه‌ها
+    size_t jointPos = 0, jointN = 0;
+    long jointCount[16] = {0};        // تعداد هر الگو در حلقه
+    long adaptiveSamples = 0;
+    long adaptiveCount = 0;
+    long reorderEvents = 0;
+    cOutVector reorderVec;            // orderId پس از هر تعویض
+
+    static int stageIndex(char c){ return c=='H' ? 0 : (c=='F' ? 1 : (c=='B' ? 2 : 3)); }
+    double stageCost(int si) const {
+        bool enabled = si==0 ? checkHmac : (si==1 ? checkFreshness : (si==2 ? checkDuplicate : true));
+        if (!enabled) return 0.0;
+        // پنجرهٔ خالی (پس از تعویض ترتیب یا مرحله‌ای که هنوز اجرا نشده) → مدل
+        return adaptiveMeasured && stageWin[si].n ? stageWin[si].avgCost() : adaptiveCost[si];
+    }
+    // حکم بی‌شرط هر مرحله بدون اثر جانبی: بدون شمارنده، انرژی، oracle و تغییر وضعیت تازگی/تکرار
+    bool stagePeek(int si, const LightIoTMessage* m){
+        switch (si) {
+            case 0: return !checkHmac || (m->getMacLen()==(size_t)tagBytes &&
+                           cmacIdTsVerify(perSensorKeys ? keyCache.get(m->getSrc()) : cmac,
+                                          m->getId(), ts_to_us(m->getTimestamp()), m->getMac(), tagBytes));
+            case 1: return !checkFreshness || freshPeek(m);
+            case 2: return !checkDuplicate || !dupPeek(m->getId());
+            default: return precheckOk(m);
+        }
+    }
+    // پیش از اجرای مراحل، روی کسر adaptiveSampleRate از پیام‌ها (شمارنده + splitmix، مستقل از id
+    // تا بازپخش یک id ثابت هم نمونه شود)
+    void sampleJoint(const LightIoTMessage* m){
+        if (jointRing.empty() || SplitMixHashPolicy::hash(++adaptiveSampleCounter) >= adaptiveSampleThreshold) return;
+        uint8_t rej = 0;
+        for (char c : stageOrder) {
+            int si = stageIndex(c);
+            if (!stagePeek(si, m)) rej |= (uint8_t)(1u << si);
+        }
+        if (jointN == jointRing.size()) jointCount[jointRing[jointPos]]--; else jointN++;
+        jointRing[jointPos] = rej;
+        jointCount[rej]++;
+        jointPos = (jointPos + 1) % jointRing.size();
+        adaptiveSamples++;
+    }
+    // کار مورد انتظار به ازای هر پیام. با نمونه: Σ_s c_s · P(همهٔ مراحل پیش از s عبور کنند) از الگوی
+    // مشترک رد، بدون فرض استقلال. بدون نمونه: c1 + (1-r1)c2 + (1-r1)(1-r2)c3 با نرخ‌های شرطی stageWin
+    // (فقط برای ترتیب فعلی دقیق است)
+    double expectedWork(int id) const {
+        const char* ord = orderName(id);
+        double work = 0.0;
+        if (jointN > 0) {
+            for (int mask = 0; mask < 16; ++mask) {
+                if (!jointCount[mask]) continue;
+                double w = 0.0;
+                for (const char* c = ord; *c; ++c) {
+                    int si = stageIndex(*c);
+                    w += stageCost(si);
+                    if (mask & (1 << si)) break;
+                }
+                work += (double)jointCount[mask] * w;
+            }
+            return work / (double)jointN;
+        }
+        double pass = 1.0;
+        for (const char* c = ord; *c; ++c) {
+            int si = stageIndex(*c);
+            work += pass * stageCost(si);
+            pass *= 1.0 - stageWin[si].rejectRate();
+        }
+        return work;
+    }
+    void maybeReorder(){
+        int best = orderId;
+        double bestWork = expectedWork(orderId), curWork = bestWork;
+        // فقط ترتیب‌های با همان مجموعهٔ مراحل (با یا بدون P)
+        const size_t len = stageOrder.size();
+        for (int id = 1; id <= NUM_ORDERS; ++id) {
+            if (std::char_traits<char>::length(ORDERS[id]) != len) continue;
+            double w = expectedWork(id);
+            if (w < bestWork) { bestWork = w; best = id; }
+        }
+        // hysteresis: فقط اگر بهبود نسبی از آستانه بیشتر باشد
+        if (best == orderId || curWork - bestWork <= adaptiveHysteresis * curWork) return;
+        EV << "[GatewayNode] adaptive order " << stageOrder << " -> " << orderName(best)
+           << " (work " << curWork << " -> " << bestWork << ")\n";
+        orderId = best;
+        stageOrder = orderName(best);
+        pipeline = selectPipeline(orderId, dupMethod, true);
+        // نرخ‌های شرطی ترتیب قبلی با ترتیب جدید معنا ندارند (الگوی مشترک به ترتیب وابسته نیست)
+        for (auto& w : stageWin) w.init((size_t)adaptiveWindow);
+        reorderEvents++;
+        reorderVec.record(orderId);
+    }
+
+    // ===== خط لوله: ترتیب مراحل × روش Duplicate، همه به‌صورت کد خطی
+    template <char S, DupMethod D, bool Track>
+    bool runStage(LightIoTMessage* m){
+        if constexpr (S == '\0') {
+            return true;             // ترتیب سه‌مرحله‌ای: جایگاه چهارم خالی
+        } else if constexpr (!Track) {
+            if constexpr (S == 'P') return stage_P(m);
+            else if constexpr (S == 'H') return stage_H(m);
+            else if constexpr (S == 'F') return stage_F(m);
+            else return stage_B<D>(m);
+        } else {
+            // نسخهٔ adaptiveOrder: نتیجه و (در صورت نیاز) زمان هر مرحله ثبت می‌شود
+            std::chrono::steady_clock::time_point t0;
+            if (adaptiveMeasured) t0 = std::chrono::steady_clock::now();
+            bool ok = runStage<S, D, false>(m);
+            double ns = adaptiveMeasured
+                ? (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count()
+                : 0.0;
+            stageWin[stageIndex(S)].add(!ok, ns);
+            return ok;
+        }
+    }
+    // false = پیام در یکی از مراحل حذف شد (شمارندهٔ همان مرحله افزایش یافته)
+    template <DupMethod D, bool Track, char S1, char S2, char S3, char S4>
+    bool runPipeline(LightIoTMessage* m){
+        return runStage<S1, D, Track>(m) && runStage<S2, D, Track>(m) &&
+               runStage<S3, D, Track>(m) && runStage<S4, D, Track>(m);
+    }
+
+    typedef bool (GatewayNode::*PipelineFn)(LightIoTMessage*);
+    typedef bool (GatewayNode::*DupInsertFn)(int);
+    PipelineFn  pipeline  = nullptr;
+    DupInsertFn dupInsertFn = nullptr;
+
+    // سطر جدول برای یک روش: اندیس = orderId (0 → HFB)، یک نمونهٔ قالب برای هر ORDERS[i]
+    typedef std::array<PipelineFn, NUM_ORDERS + 1> PipelineRow;
+    template <DupMethod D, bool Track, size_t... I>
+    static PipelineRow pipelineRowImpl(std::index_sequence<I...>){
+        return {{ &GatewayNode::runPipeline<D, Track, ORDERS[I][0], ORDERS[I][1], ORDERS[I][2], ORDERS[I][3]>... }};
+    }
+    template <DupMethod D, bool Track>
+    static PipelineRow pipelineRow(){
+        return pipelineRowImpl<D, Track>(std::make_index_sequence<NUM_ORDERS + 1>());
+    }
+    template <bool Track>
+    static std::array<PipelineRow, DUP_COUNT> pipelineTable(){
+        return {{ pipelineRow<DUP_SET,Track>(), pipelineRow<DUP_FLATSET,Track>(), pipelineRow<DUP_BLOOM,Track>(),
+                  pipelineRow<DUP_BLOCKED_BLOOM,Track>(), pipelineRow<DUP_AGED_BLOOM,Track>(),
+                  pipelineRow<DUP_CUCKOO,Track>(), pipelineRow<DUP_SBF,Track>() }};
+    }
+    // (orderId, روش, ردیابی تطبیقی) → نمونهٔ قالب؛ در initialize و هنگام تعویض ترتیب
+    static PipelineFn selectPipeline(int orderId, DupMethod d, bool track){
+        static const std::array<PipelineRow, DUP_COUNT> PLAIN = pipelineTable<false>();
+        static const std::array<PipelineRow, DUP_COUNT> TRACKED = pipelineTable<true>();
+        int o = (orderId >= 1 && orderId <= NUM_ORDERS) ? orderId : 0;
+        return track ? TRACKED[d][o] : PLAIN[d][o];
+    }
+    // یک مرحلهٔ تنها (حالت دسته‌ای: مراحل پیش و پس از H جدا اجرا می‌شوند)؛ اندیس = stageIndex
+    typedef std::array<PipelineFn, 4> StageRow;
+    template <DupMethod D, bool Track>
+    static StageRow stageRow(){
+        return {{ &GatewayNode::runStage<'H',D,Track>, &GatewayNode::runStage<'F',D,Track>,
+                  &GatewayNode::runStage<'B',D,Track>, &GatewayNode::runStage<'P',D,Track> }};
+    }
+    template <bool Track>
+    static std::array<StageRow, DUP_COUNT> stageTable(){
+        return {{ stageRow<DUP_SET,Track>(), stageRow<DUP_FLATSET,Track>(), stageRow<DUP_BLOOM,Track>(),
+                  stageRow<DUP_BLOCKED_BLOOM,Track>(), stageRow<DUP_AGED_BLOOM,Track>(),
+                  stageRow<DUP_CUCKOO,Track>(), stageRow<DUP_SBF,Track>() }};
+    }
+    static PipelineFn selectStage(char c, DupMethod d, bool track){
+        static const std::array<StageRow, DUP_COUNT> PLAIN = stageTable<false>();
+        static const std::array<StageRow, DUP_COUNT> TRACKED = stageTable<true>();
+        return track ? TRACKED[d][stageIndex(c)] : PLAIN[d][stageIndex(c)];
+    }
+    static DupInsertFn selectDupInsert(DupMethod d){
+        static const std::array<DupInsertFn, DUP_COUNT> TABLE = {{
+            &GatewayNode::dupInsert<DUP_SET>, &GatewayNode::dupInsert<DUP_FLATSET>, &GatewayNode::dupInsert<DUP_BLOOM>,
+            &GatewayNode::dupInsert<DUP_BLOCKED_BLOOM>, &GatewayNode::dupInsert<DUP_AGED_BLOOM>,
+            &GatewayNode::dupInsert<DUP_CUCKOO>, &GatewayNode::dupInsert<DUP_SBF> }};
+        return TABLE[d];
+    }
+
   protected:
     virtual void initialize() override {
         // انرژی
@@ -255,15 +707,122 @@ class GatewayNode : public cSimpleModule {
         battery         = batteryInit;
         costForward     = par("costForward_mJ").doubleValue();
         costVerify      = par("costVerify_mJ").doubleValue();
+        costPrecheck    = hasPar("costPrecheck_mJ") ? par("costPrecheck_mJ").doubleValue() : costPrecheck;
+        precheckFutureSkew = hasPar("precheckFutureSkew") ? par("precheckFutureSkew").doubleValue() : 0.01;
+        rxCostPerByte   = par("rxCostPerByte_mJ").doubleValue();
+        txCostPerByte   = par("txCostPerByte_mJ").doubleValue();
 
         // امنیت/زمان
         securityEnabled = par("securityEnabled").boolValue();
         checkHmac       = par("checkHmac").boolValue();
         checkFreshness  = par("checkFreshness").boolValue();
         checkDuplicate  = par("checkDuplicate").boolValue();
+        tagBytes        = par("tagBytes").intValue();
+        if (!LightIoTMessage::isValidTagBytes(tagBytes)) {
+            EV << "[GatewayNode] Invalid tagBytes " << tagBytes << "; using 16.\n";
+            tagBytes = 16;
+        }
+        // جدول تازگی
+        numSensors = hasPar("numSensors") ? par("numSensors").intValue() : -1;
+        if (numSensors < 0) {
+            cModule* net = getParentModule();
+            numSensors = (net && net->hasPar("numSensorNodes")) ? net->par("numSensorNodes").intValue() : 0;
+        }
+        freshOverflowSize   = hasPar("freshOverflowSize") ? par("freshOverflowSize").intValue() : freshOverflowSize;
+        freshOverflowPolicy = hasPar("freshOverflowPolicy") ? par("freshOverflowPolicy").stdstringValue() : freshOverflowPolicy;
+        if (freshOverflowPolicy != "evict" && freshOverflowPolicy != "drop") {
+            EV << "[GatewayNode] Invalid freshOverflowPolicy '" << freshOverflowPolicy << "'; using evict.\n";
+            freshOverflowPolicy = "evict";
+        }
+        idStride = LightIoTMessage::idStrideFor(numSensors);
+        auto policy = freshOverflowPolicy == "drop" ? SourceTable<FreshState>::DROP : SourceTable<FreshState>::EVICT;
+        cModule* net = getParentModule();
+        numGateways = (net && net->hasPar("numGateways")) ? std::max(1, (int)net->par("numGateways").intValue()) : 1;
+        if (numGateways > 1 && isVector() && net->hasPar("sensorsPerGateway")) {
+            // شبکهٔ سلسله‌مراتبی: هر Gateway بازهٔ پیوسته‌ای از سنسورها (از طریق aggregatorها)
+            shardIndex = getIndex();
+            int per = (int)net->par("sensorsPerGateway").intValue();
+            int first = std::min(numSensors, shardIndex * per);
+            shardSensors = std::min(numSensors, first + per) - first;
+            freshTable.init((size_t)shardSensors, (size_t)std::max(1, freshOverflowSize), policy);
+            freshTable.setDenseBase(first);
+            EV << "[GatewayNode] shard " << shardIndex << "/" << numGateways << ": sensors "
+               << first << ".." << first + shardSensors - 1 << "\n";
+        } else if (numGateways > 1 && isVector()) {
+            // شارد: آرایهٔ پیوسته فقط برای سنسورهای خودش، بقیه مانند منبع ناشناس
+            shardIndex = getIndex();
+            ShardRing ring;
+            ring.init(numGateways, net->hasPar("gatewayVnodes") ? (int)net->par("gatewayVnodes").intValue() : 64);
+            std::vector<int32_t> slotOf((size_t)numSensors, -1);
+            shardSensors = 0;
+            for (int i = 0; i < numSensors; ++i)
+                if (ring.shardOf(i) == shardIndex) slotOf[(size_t)i] = shardSensors++;
+            freshTable.init((size_t)shardSensors, (size_t)std::max(1, freshOverflowSize), policy);
+            freshTable.mapSources(std::move(slotOf));
+            EV << "[GatewayNode] shard " << shardIndex << "/" << numGateways << ": " << shardSensors << " sensors\n";
+        } else {
+            shardSensors = numSensors;
+            freshTable.init((size_t)numSensors, (size_t)std::max(1, freshOverflowSize), policy);
+        }
+
+        replayWindow = hasPar("replayWindow") ? par("replayWindow").intValue() : replayWindow;
+        if (replayWindow > 64) {
+            ReplayRing probe;
+            probe.init((size_t)replayWindow);
+            if ((int)probe.bits() != replayWindow)
+                EV << "[GatewayNode] replayWindow " << replayWindow << " -> " << probe.bits() << " bits\n";
+            replayWindow = (int)probe.bits();
+        } else if (replayWindow < 1) {
+            replayWindow = 64;
+        }
+
         hmacWindow      = par("hmacWindow");
         procDelay       = par("procDelay");
 
+        // micro-batching
+        batchSize       = hasPar("batchSize") ? par("batchSize").intValue() : 1;
+        batchTimeout    = hasPar("batchTimeout") ? par("batchTimeout").doubleValue() : 0.01;
+        batchCostFixed  = hasPar("batchCostFixed_mJ") ? par("batchCostFixed_mJ").doubleValue() : 0.0;
+        batchCostPerMsg = hasPar("batchCostPerMsg_mJ") ? par("batchCostPerMsg_mJ").doubleValue() : -1.0;
+        if (batchCostPerMsg < 0) batchCostPerMsg = costVerify;
+        if (batchSize < 1) batchSize = 1;
+        if (batchSize > 1) {
+            if (batchTimeout <= SIMTIME_ZERO) {
+                EV << "[GatewayNode] Invalid batchTimeout; using 10ms.\n";
+                batchTimeout = 0.01;
+            }
+            batch.reserve((size_t)batchSize);
+            batchTimer = new cMessage("batchTimer");
+            batchSizeVec.setName("batchSize");
+            batchWaitVec.setName("batchWait");
+            batchThroughputVec.setName("batchThroughput");
+        }
+
+        // مدل صف
+        verifierCores = hasPar("verifierCores") ? par("verifierCores").intValue() : 0;
+        bufferSize    = hasPar("bufferSize") ? par("bufferSize").intValue() : bufferSize;
+        std::string qp = hasPar("queuePolicy") ? par("queuePolicy").stdstringValue() : "droptail";
+        if (qp != "droptail" && qp != "dropoldest") {
+            EV << "[GatewayNode] Invalid queuePolicy '" << qp << "'; using droptail.\n";
+            qp = "droptail";
+        }
+        queueDropOldest = (qp == "dropoldest");
+        if (hasPar("serviceTimeP")) serviceTimeP = par("serviceTimeP");
+        if (hasPar("serviceTimeH")) serviceTimeH = par("serviceTimeH");
+        if (hasPar("serviceTimeF")) serviceTimeF = par("serviceTimeF");
+        if (hasPar("serviceTimeB")) serviceTimeB = par("serviceTimeB");
+        if (bufferSize < 0) bufferSize = 0;
+        if (verifierCores > 0) {
+            if (batchSize > 1) {
+                EV << "[GatewayNode] batchSize ignored with verifierCores > 0 (per-message service).\n";
+                batchSize = 1;
+            }
+            for (int c = 0; c < verifierCores; ++c) coreTimers.push_back(new cMessage("serviceDone"));
+            freeCores = coreTimers;
+            queueLenVec.setName("queueLength");
+            queueWaitVec.setName("queueWait");
+        }
+
         // ترتیب
         int idFromPar = (hasPar("stageOrderId") ? par("stageOrderId").intValue() : 0);
         std::string ordFromPar;
@@ -273,11 +832,10 @@ class GatewayNode : public cSimpleModule {
         // نرمال‌سازی رشته ورودی (اجازه می‌دهد H/F/B با ترتیب دلخواه یا کاراکترهای اضافی داده شود)
         std::string ordNorm = normalizeOrder(ordFromPar);
 
-        if (idFromPar >= 1 && idFromPar <= 6) {
+        if (idFromPar >= 1 && idFromPar <= NUM_ORDERS) {
             // اگر شناسه به‌صورت عددی داده شده باشد، بر رشته مقدم است
-            static const char* LUT[] = {"", "HFB", "HBF", "FHB", "FBH", "BHF", "BFH"};
             orderId   = idFromPar;
-            stageOrder = LUT[orderId];
+            stageOrder = orderName(orderId);
         } else if (!ordNorm.empty()) {
             // در غیر این صورت از رشته استفاده می‌کنیم
             stageOrder = ordNorm;
@@ -294,94 +852,444 @@ class GatewayNode : public cSimpleModule {
             EV << "[GatewayNode] Invalid aesKeyHex; expected 16-byte hex.\n";
             keyBytes.assign(16, 0);
         }
+        cmac.init(keyBytes.data());
+        EV << "[GatewayNode] AES backend: " << aes128_backend_name()
+           << ", dedup hash: " << DedupHash::name() << "\n";
+
+        perSensorKeys = par("perSensorKeys").boolValue();
+        keyCacheSize  = par("keyCacheSize").intValue();
+        if (keyCacheSize < 1) keyCacheSize = 1;
+        if (perSensorKeys) keyCache.init(cmac, (size_t)keyCacheSize);
 
         // روش Duplicate
         duplicateMethod = par("duplicateMethod").stdstringValue();
-        if (duplicateMethod != "set" && duplicateMethod != "bloom" && duplicateMethod != "sbf")
+        if (duplicateMethod != "set" && duplicateMethod != "flatset" &&
+            duplicateMethod != "bloom" && duplicateMethod != "blocked_bloom" &&
+            duplicateMethod != "aged_bloom" && duplicateMethod != "cuckoo" &&
+            duplicateMethod != "sbf")
             duplicateMethod = "set";
+        dupMethod = dupMethodFromStr(duplicateMethod);
+
+        // مدل انرژی بررسی
+        std::string energyModel = hasPar("energyModel") ? par("energyModel").stdstringValue() : "flat";
+        if (energyModel != "flat" && energyModel != "stage") {
+            EV << "[GatewayNode] Invalid energyModel '" << energyModel << "'; using flat.\n";
+            energyModel = "flat";
+        }
+        stageEnergy = (energyModel == "stage");
+        if (hasPar("costH_mJ")) costH = par("costH_mJ").doubleValue();
+        if (hasPar("costF_mJ")) costF = par("costF_mJ").doubleValue();
+        double costBPar = hasPar("costB_mJ") ? par("costB_mJ").doubleValue() : -1.0;
+        std::string costBSpec = hasPar("costBMethod_mJ") ? par("costBMethod_mJ").stdstringValue() : "";
+        if (costBPar >= 0) costB = costBPar;
+        else if (!methodCostFromSpec(costBSpec, duplicateMethod, costB))
+            EV << "[GatewayNode] No B cost for '" << duplicateMethod << "' in costBMethod_mJ; using " << costB << ".\n";
 
         bloomBits   = hasPar("bloomBits")   ? par("bloomBits").intValue()   : bloomBits;
         bloomHashes = hasPar("bloomHashes") ? par("bloomHashes").intValue() : bloomHashes;
         sbfBits     = hasPar("sbfBits")     ? par("sbfBits").intValue()     : sbfBits;
         sbfHashes   = hasPar("sbfHashes")   ? par("sbfHashes").intValue()   : sbfHashes;
         sbfDecay    = hasPar("sbfDecay")    ? par("sbfDecay").doubleValue() : sbfDecay;
+        sbfDecayPeriod = hasPar("sbfDecayPeriod") ? par("sbfDecayPeriod").doubleValue() : 0.0;
+        flatsetCapacity  = hasPar("flatsetCapacity")  ? par("flatsetCapacity").intValue() : flatsetCapacity;
+        flatsetRetention = hasPar("flatsetRetention") ? par("flatsetRetention").doubleValue() : 0.0;
+        agedBloomGenerations = hasPar("agedBloomGenerations") ? par("agedBloomGenerations").intValue() : agedBloomGenerations;
+        cuckooCapacity   = hasPar("cuckooCapacity")   ? par("cuckooCapacity").intValue()   : cuckooCapacity;
+        cuckooFpBits     = hasPar("cuckooFpBits")     ? par("cuckooFpBits").intValue()     : cuckooFpBits;
+        cuckooBucketSize = hasPar("cuckooBucketSize") ? par("cuckooBucketSize").intValue() : cuckooBucketSize;
+        cuckooMaxKicks   = hasPar("cuckooMaxKicks")   ? par("cuckooMaxKicks").intValue()   : cuckooMaxKicks;
+        cuckooRetention  = hasPar("cuckooRetention")  ? par("cuckooRetention").doubleValue() : 0.0;
 
-        if (duplicateMethod == "bloom") {
+        if (duplicateMethod == "flatset") {
+            if (flatsetCapacity < 8) flatsetCapacity = 8;
+            if (flatsetRetention <= SIMTIME_ZERO) flatsetRetention = hmacWindow;
+            flatSet.init((size_t)flatsetCapacity, ts_to_us(flatsetRetention));
+        } else if (duplicateMethod == "cuckoo") {
+            if (cuckooCapacity < 8) cuckooCapacity = 8;
+            if (cuckooRetention <= SIMTIME_ZERO) cuckooRetention = hmacWindow;
+            cuckoo.init((size_t)cuckooCapacity, cuckooFpBits, cuckooBucketSize, cuckooMaxKicks, ts_to_us(cuckooRetention));
+            if (cuckoo.fpBits() != cuckooFpBits || cuckoo.bucketSize() != cuckooBucketSize)
+                EV << "[GatewayNode] cuckoo: fpBits=" << cuckoo.fpBits() << " bucketSize=" << cuckoo.bucketSize() << " (clamped)\n";
+        } else if (duplicateMethod == "bloom") {
             if (bloomBits < 8) bloomBits = 8;
             if (bloomHashes < 1) bloomHashes = 1;
             bloomInit(bloomBits);
+        } else if (duplicateMethod == "blocked_bloom") {
+            if (bloomBits < (int)BlockedBloom::BLOCK_BITS) bloomBits = (int)BlockedBloom::BLOCK_BITS;
+            if (bloomHashes < 1) bloomHashes = 1;
+            blockedBloom.init((size_t)bloomBits, bloomHashes);
+            if ((int)blockedBloom.bits() != bloomBits)
+                EV << "[GatewayNode] blocked_bloom: bloomBits rounded up to " << blockedBloom.bits() << "\n";
+            bloomBits   = (int)blockedBloom.bits();
+            bloomHashes = blockedBloom.hashes();
+        } else if (duplicateMethod == "aged_bloom") {
+            if (agedBloomGenerations < 1) agedBloomGenerations = 1;
+            if (bloomHashes < 1) bloomHashes = 1;
+            int64_t slice = ts_to_us(hmacWindow) / agedBloomGenerations;
+            agedBloom.init((size_t)std::max(1, bloomBits / agedBloomGenerations), bloomHashes, agedBloomGenerations, slice);
+            agedBloomGenerations = agedBloom.generations();
+            bloomHashes = agedBloom.hashes();
+            bloomBits = (int)(agedBloom.bitsPerGeneration() * (size_t)agedBloomGenerations);
+            EV << "[GatewayNode] aged_bloom: " << agedBloomGenerations << " x " << agedBloom.bitsPerGeneration()
+               << " bits, slice " << agedBloom.slice() << " us\n";
         } else if (duplicateMethod == "sbf") {
-            if (sbfBits < 8) sbfBits = 8;
+            if (sbfBits < 64) sbfBits = 64;
             if (sbfHashes < 1) sbfHashes = 1;
-            sbfInit(sbfBits);
+            sbf.init((size_t)sbfBits, sbfHashes, sbfDecayPeriod > SIMTIME_ZERO ? ts_to_us(sbfDecayPeriod) : 0);
+            if ((int)sbf.bits() != sbfBits)
+                EV << "[GatewayNode] sbf: sbfBits rounded up to " << sbf.bits() << "\n";
+            sbfBits   = (int)sbf.bits();
+            sbfHashes = sbf.hashes();
         }
-        if ((duplicateMethod=="bloom" || duplicateMethod=="sbf") && std::max(bloomBits,sbfBits) < 1024) {
+        // oracle فقط برای روش‌های تقریبی لازم است
+        fpOracleSpec = hasPar("fpOracle") ? par("fpOracle").stdstringValue() : fpOracleSpec;
+        if (!oracle.configure(fpOracleSpec))
+            EV << "[GatewayNode] Invalid fpOracle '" << fpOracleSpec << "'; using full.\n";
+        if (!checkDuplicate || duplicateMethod == "set" || duplicateMethod == "flatset")
+            oracle.disable();
+
+        if ((duplicateMethod=="bloom" || duplicateMethod=="blocked_bloom" ||
+             duplicateMethod=="aged_bloom" || duplicateMethod=="sbf") && std::max(bloomBits,sbfBits) < 1024) {
             EV << "[GatewayNode][WARN] bloom/sbf bits < 1024\n";
         }
 
+        // ترتیب تطبیقی
+        adaptiveOrder      = hasPar("adaptiveOrder") ? par("adaptiveOrder").boolValue() : false;
+        adaptiveWindow     = hasPar("adaptiveWindow") ? par("adaptiveWindow").intValue() : adaptiveWindow;
+        adaptiveInterval   = hasPar("adaptiveInterval") ? par("adaptiveInterval").intValue() : adaptiveInterval;
+        adaptiveHysteresis = hasPar("adaptiveHysteresis") ? par("adaptiveHysteresis").doubleValue() : adaptiveHysteresis;
+        adaptiveSampleRate = hasPar("adaptiveSampleRate") ? par("adaptiveSampleRate").doubleValue() : adaptiveSampleRate;
+        std::string costSrc = hasPar("adaptiveCostSource") ? par("adaptiveCostSource").stdstringValue() : "model";
+        if (costSrc != "model" && costSrc != "measured") {
+            EV << "[GatewayNode] Invalid adaptiveCostSource '" << costSrc << "'; using model.\n";
+            costSrc = "model";
+        }
+        adaptiveMeasured = (costSrc == "measured");
+        if (hasPar("adaptiveCostH")) adaptiveCost[0] = par("adaptiveCostH").doubleValue();
+        if (hasPar("adaptiveCostF")) adaptiveCost[1] = par("adaptiveCostF").doubleValue();
+        if (hasPar("adaptiveCostB")) adaptiveCost[2] = par("adaptiveCostB").doubleValue();
+        if (hasPar("adaptiveCostP")) adaptiveCost[3] = par("adaptiveCostP").doubleValue();
+        if (adaptiveWindow < 1) adaptiveWindow = 1;
+        if (adaptiveInterval < 1) adaptiveInterval = 1;
+        if (adaptiveHysteresis < 0) adaptiveHysteresis = 0;
+        if (!(adaptiveSampleRate >= 0.0 && adaptiveSampleRate <= 1.0)) {
+            EV << "[GatewayNode] Invalid adaptiveSampleRate " << adaptiveSampleRate << "; using 0.05.\n";
+            adaptiveSampleRate = 0.05;
+        }
+        if (adaptiveOrder) {
+            for (auto& w : stageWin) w.init((size_t)adaptiveWindow);
+            if (adaptiveSampleRate > 0.0) {
+                // مانند FpOracle: p · 2^64 با اشباع
+                double t = std::ldexp(adaptiveSampleRate, 64);
+                adaptiveSampleThreshold = (t >= 18446744073709551616.0) ? UINT64_MAX : (uint64_t)t;
+                jointRing.assign((size_t)adaptiveWindow, 0);
+            }
+            reorderVec.setName("stageOrderId");
+            reorderVec.record(orderId);
+        }
+
+        pipeline    = selectPipeline(orderId, dupMethod, adaptiveOrder);
+        dupInsertFn = selectDupInsert(dupMethod);
+
         bloomCallsVec.setName("q_bloom_calls");
         bloomInsertsVec.setName("q_bloom_inserts");
     }
 
+    // CMAC همهٔ پیام‌های دسته با کلید مشترک، 64 تایی (aes128_cmac_verify_batch)
+    // فقط پیام‌های batch[0..n) که به مرحلهٔ H رسیده‌اند
+    void verifyBatchHmac(size_t n){
+        uint8_t buf[64][ID_TS_BYTES];
+        CmacVerifyItem items[64];
+        size_t idx[64];
+        for (size_t base = 0; base < n; base += 64) {
+            size_t cnt = 0;
+            for (size_t i = base; i < n && i < base + 64; ++i) {
+                LightIoTMessage* m = batch[i];
+                if (m->getMacLen() != (size_t)tagBytes) { batchHmacRes[i] = 0; continue; }
+                packIdTsBigEndian(m->getId(), ts_to_us(m->getTimestamp()), buf[cnt]);
+                items[cnt] = { buf[cnt], ID_TS_BYTES, m->getMac(), (size_t)tagBytes };
+                idx[cnt++] = i;
+            }
+            uint64_t pass = aes128_cmac_verify_batch(cmac, items, cnt);
+            for (size_t c = 0; c < cnt; ++c) batchHmacRes[idx[c]] = (int8_t)((pass >> c) & 1u);
+        }
+    }
+
+    // انرژی بررسی هر پیام دسته (بدون سهم ثابت دسته): flat → batchCostPerMsg، stage → مراحل اجراشده
+    double batchVerifyCost() const {
+        return securityEnabled ? (stageEnergy ? verifyReserve() : batchCostPerMsg) : 0.0;
+    }
+    // رزرو هنگام ورود به دسته: بررسی + سهم سرشکن‌شدهٔ batchCostFixed + فوروارد
+    double batchReserve(const LightIoTMessage* m) const {
+        return batchVerifyCost() + (securityEnabled ? batchCostFixed / (double)batchSize : 0.0)
+             + costForward + txCostPerByte * (double)m->getByteLength();
+    }
+
+    // اجرای خط لوله برای کل دسته؛ با پر شدن دسته یا انقضای batchTimer
+    // 0) آزاد کردن رزرو ورود؛ batchCostFixed برای کل دسته نگه داشته می‌شود
+    // 1) بررسی دوبارهٔ باتری برای هر پیام، سپس مراحل پیش از H (حذف زودهنگام بدون CMAC)
+    // 2) CMAC دسته‌ای فقط برای بازماندگانی که به H می‌رسند
+    // 3) H (نتیجهٔ آماده) و مراحل بعد از آن
+    void flushBatch(bool timeout){
+        cancelEvent(batchTimer);
+        const size_t n = batch.size();
+        if (n == 0) return;
+        batches++;
+        batchMessages += (long)n;
+        if (timeout) batchTimeoutFlushes++;
+
+        const simtime_t now = simTime();
+        batchSizeVec.record((double)n);
+        if (now > lastFlush) batchThroughputVec.record((double)n / SIMTIME_DBL(now - lastFlush));
+        lastFlush = now;
+
+        // ترتیب در ابتدای دسته ثابت می‌ماند (maybeReorder در میانهٔ دسته فقط pipeline را عوض می‌کند)
+        PipelineFn fns[4];
+        size_t len = 0, hpos = 0;
+        if (securityEnabled) {
+            const char* ord = orderName(orderId);
+            for (; ord[len]; ++len) {
+                fns[len] = selectStage(ord[len], dupMethod, adaptiveOrder);
+                if (ord[len] == 'H') hpos = len;
+            }
+        }
+
+        for (size_t i = 0; i < n; ++i) pendingForward -= batchReserve(batch[i]);
+        const double fixed = securityEnabled ? batchCostFixed : 0.0;
+        pendingForward += fixed;
+
+        size_t reachH = 0;   // بازماندگان، فشرده در ابتدای batch
+        for (size_t i = 0; i < n; ++i) {
+            LightIoTMessage* m = batch[i];
+            double wait = SIMTIME_DBL(now - m->getArrivalTime());
+            batchWaitSum += wait;
+            batchWaitMax = std::max(batchWaitMax, wait);
+            batchWaitVec.record(wait);
+            // پیام‌های پیشین دسته از باتری کسر کرده‌اند؛ آنچه نماند حذف می‌شود
+            const double fwdCost = costForward + txCostPerByte * (double)m->getByteLength();
+            if (battery - pendingForward < batchVerifyCost() + fwdCost) {
+                EV << "[GatewayNode] Battery depleted at batch flush. Drop.\n";
+                totalDroppedBattery++;
+                delete m;
+                continue;
+            }
+            // مدل flat: هر پیام دریافتی، مانند chargeFlatVerify در مسیر تک‌پیامی
+            // (مدل stage: سهم هر پیام همان مراحل اجراشده است)
+            if (securityEnabled && !stageEnergy) { battery -= batchCostPerMsg; batchEnergy += batchCostPerMsg; }
+            if (securityEnabled && adaptiveOrder) sampleJoint(m);
+            bool ok = true;
+            for (size_t k = 0; k < hpos && ok; ++k) ok = (this->*fns[k])(m);
+            if (!ok) { afterPipeline(m, false); delete m; continue; }
+            // رزرو بقیهٔ مسیر بازمانده تا مرحلهٔ 3
+            pendingForward += (stageEnergy ? batchVerifyCost() : 0.0) + fwdCost;
+            batch[reachH++] = m;
+        }
+
+        // بخش ثابت دسته فقط وقتی CMAC دسته‌ای اجرا شود
+        pendingForward -= fixed;
+        if (securityEnabled && reachH > 0) {
+            battery -= fixed;
+            batchEnergy += fixed;
+        }
+        batchHmacRes.assign(reachH, -1);
+        if (securityEnabled && checkHmac && !perSensorKeys) verifyBatchHmac(reachH);
+
+        for (size_t i = 0; i < reachH; ++i) {
+            LightIoTMessage* m = batch[i];
+            pendingForward -= (stageEnergy ? batchVerifyCost() : 0.0)
+                            + costForward + txCostPerByte * (double)m->getByteLength();
+            batchHmac = batchHmacRes[i];
+            bool ok = true;
+            for (size_t k = hpos; k < len && ok; ++k) ok = (this->*fns[k])(m);
+            if (afterPipeline(m, ok)) forward(m, procDelay);
+            else delete m;
+        }
+        batchHmac = -1;
+        batch.clear();
+    }
+
+    // خط لوله + ثبت؛ false = پیام در یکی از مراحل حذف شد (شمارندهٔ همان مرحله افزایش یافته)
+    bool runChecks(LightIoTMessage* m){
+        // اجرای مراحل به ترتیب stageOrder (نمونهٔ قالب انتخاب‌شده در initialize)
+        if (!securityEnabled) return afterPipeline(m, true);
+        if (adaptiveOrder) sampleJoint(m);
+        return afterPipeline(m, (this->*pipeline)(m));
+    }
+
+    // پس از اجرای مراحل: ترتیب تطبیقی و ثبت پیام پذیرفته‌شده
+    bool afterPipeline(LightIoTMessage* m, bool ok){
+        if (securityEnabled) {
+            if (adaptiveOrder && ++adaptiveCount >= adaptiveInterval) { adaptiveCount = 0; maybeReorder(); }
+            if (!ok) return false;
+        }
+
+        // در صورت عبور، «ثبت برای دفعات بعد»؛ اگر ثبت نشود تکرار بعدی قابل تشخیص نیست → حذف (fail-closed)
+        int id = m->getId();
+        if (checkDuplicate && !(this->*dupInsertFn)(id)) { totalDroppedDedupFull++; return false; }
+        oracle.recordAccepted(id);   // در حالت off هیچ کاری نمی‌کند
+        return true;
+    }
+
+    // هزینه ارسال و فوروارد
+    void forward(LightIoTMessage* m, simtime_t delay){
+        const int64_t bytes = m->getByteLength();
+        battery -= costForward + txCostPerByte * (double)bytes;
+        totalAccepted++;
+        txBytes += bytes;
+
+        if (delay > SIMTIME_ZERO) sendDelayed(m, delay, "out");
+        else send(m, "out");
+    }
+
+    // هزینهٔ دریافت و بررسی پیش‌تر کسر شده است
+    void processMessage(LightIoTMessage* m){
+        if (!runChecks(m)) { delete m; return; }
+        forward(m, procDelay);
+    }
+
+    // ===== مدل صف
+    // انتگرال طول صف و هسته‌های مشغول تا این لحظه (پیش از هر تغییر صدا زده می‌شود)
+    void noteQueueState(){
+        const simtime_t now = simTime();
+        double dt = SIMTIME_DBL(now - lastQueueChange);
+        queueArea += (double)waitQueue.size() * dt;
+        busyArea  += (double)(coreTimers.size() - freeCores.size()) * dt;
+        lastQueueChange = now;
+    }
+
+    void enqueueOrServe(LightIoTMessage* m){
+        noteQueueState();
+        if (!freeCores.empty()) { startService(m); return; }
+        if ((int)waitQueue.size() >= bufferSize) {
+            totalDroppedQueue++;
+            if (queueDropOldest && !waitQueue.empty()) {
+                delete waitQueue.front();
+                waitQueue.pop_front();
+                waitQueue.push_back(m);
+            } else {
+                delete m;
+            }
+            return;
+        }
+        waitQueue.push_back(m);
+        queueLenMax = std::max(queueLenMax, waitQueue.size());
+        queueLenVec.record((double)waitQueue.size());
+    }
+
+    // مراحل در شروع سرویس اجرا می‌شوند؛ زمان سرویس از مراحلی که اجرا شدند به دست می‌آید
+    void startService(LightIoTMessage* m){
+        // باتری هنگام ورود بررسی شد، اما پیام‌های صف‌شدهٔ پیش از این پیام هم از آن کسر کرده‌اند؛
+        // دوباره بررسی با کسر فوروارد رزروشدهٔ پیام‌های در حال سرویس (بدون اشغال هسته)
+        const double fwdCost = costForward + txCostPerByte * (double)m->getByteLength();
+        const double verify = securityEnabled ? verifyReserve() : 0.0;
+        if (battery - pendingForward < verify + fwdCost) {
+            EV << "[GatewayNode] Battery depleted at service start. Drop.\n";
+            totalDroppedBattery++;
+            delete m;
+            return;
+        }
+
+        cMessage* done = freeCores.back();
+        freeCores.pop_back();
+        const simtime_t now = simTime();
+        double wait = SIMTIME_DBL(now - m->getArrivalTime());
+        queueWaitSum += wait;
+        queueWaitMax = std::max(queueWaitMax, wait);
+        queueWaitVec.record(wait);
+
+        const long p0 = workP_checks, h0 = workH_checks, f0 = workF_checks, b0 = workB_checks;
+        if (securityEnabled) chargeFlatVerify(costVerify); // هزینه ثابتِ بررسی (مدل flat)
+        bool ok = runChecks(m);
+        simtime_t svc = procDelay
+            + serviceTimeP * (double)(workP_checks - p0) + serviceTimeH * (double)(workH_checks - h0)
+            + serviceTimeF * (double)(workF_checks - f0) + serviceTimeB * (double)(workB_checks - b0);
+        served++;
+        serviceSum += SIMTIME_DBL(svc);
+        if (!ok) { delete m; m = nullptr; }
+        else pendingForward += fwdCost;
+        done->setContextPointer(m);
+        scheduleAt(now + svc, done);
+    }
+
+    void serviceDone(cMessage* done){
+        noteQueueState();
+        auto* m = static_cast<LightIoTMessage*>(done->getContextPointer());
+        done->setContextPointer(nullptr);
+        freeCores.push_back(done);
+        if (m) {
+            pendingForward -= costForward + txCostPerByte * (double)m->getByteLength();
+            forward(m, SIMTIME_ZERO);
+        }
+        // پیامی که در شروع سرویس حذف شود هسته را نگه نمی‌دارد؛ تا آزاد بودن هسته ادامه بده
+        while (!freeCores.empty() && !waitQueue.empty()) {
+            LightIoTMessage* next = waitQueue.front();
+            waitQueue.pop_front();
+            queueLenVec.record((double)waitQueue.size());
+            startService(next);
+        }
+    }
+
     virtual void handleMessage(cMessage *msg) override {
+        if (msg == batchTimer) { flushBatch(true); return; }
+        if (msg->isSelfMessage()) { serviceDone(msg); return; }
         auto *m = check_and_cast<LightIoTMessage*>(msg);
         inReceived++;
+        const int64_t bytes = m->getByteLength();
+        rxBytes += bytes;
 
         // انرژی حداقلی برای پردازش این پیام
-        double need = costForward + (securityEnabled ? costVerify : 0.0);
-        if (battery < need) {
+        const bool batching = batchSize > 1;
+        double rxCost = rxCostPerByte * (double)bytes;
+        double txCost = txCostPerByte * (double)bytes;
+        // دسته: بررسی + سهم batchCostFixed + فوروارد تا flush رزرو می‌شود
+        double need = rxCost + (batching ? batchReserve(m)
+                                         : costForward + txCost + (securityEnabled ? verifyReserve() : 0.0));
+        if (battery - pendingForward < need) {
             EV << "[GatewayNode] Battery depleted. Drop.\n";
             totalDroppedDup++; // شمردن در dup برای سادگی
             delete m;
             return;
         }
 
-        if (securityEnabled) {
-            battery -= costVerify; // هزینه ثابتِ بررسی
-            // اجرای مراحل به ترتیب stageOrder
-            for (char c : stageOrder) {
-                bool ok = true;
-                if (c=='H') ok = stage_H(m);
-                else if (c=='F') ok = stage_F(m);
-                else if (c=='B') ok = stage_B(m);
-                if (!ok) { delete m; return; } // درون مرحلۀ مربوطه شمارنده حذف افزایش یافته است
-            }
-        }
+        battery -= rxCost;
 
-        // در صورت عبور، «ثبت برای دفعات بعد»
-        int id = m->getId();
-        truthSeenIds.insert(id);
-        if (checkDuplicate) {
-            if (duplicateMethod == "set") {
-                seenIds.insert(id);
-            } else if (duplicateMethod == "bloom") {
-                bloomInserts++; bloomInsertsVec.record(1);
-                bloomAdd_id(id);
-            } else {
-                bloomInserts++; bloomInsertsVec.record(1);
-                sbfAdd_id(id);
-            }
+        if (verifierCores > 0) { enqueueOrServe(m); return; }
+        if (batching) {
+            pendingForward += batchReserve(m);
+            if (batch.empty()) scheduleAt(simTime() + batchTimeout, batchTimer);
+            batch.push_back(m);
+            if ((int)batch.size() >= batchSize) flushBatch(false);
+            return;
         }
-
-        // هزینه ارسال و فوروارد
-        battery -= costForward;
-        totalAccepted++;
-
-        if (procDelay > SIMTIME_ZERO) sendDelayed(m, procDelay, "out");
-        else send(m, "out");
+        if (securityEnabled) chargeFlatVerify(costVerify); // هزینه ثابتِ بررسی (مدل flat)
+        processMessage(m);
     }
 
     virtual void finish() override {
         // صحت مجموع شمارش‌ها
-        int totalDrops = totalDroppedHmac + totalDroppedReplay + totalDroppedDup;
-        if (inReceived != (totalAccepted + totalDrops)) mismatchCounter++;
+        int totalDrops = totalDroppedPrecheck + totalDroppedHmac + totalDroppedReplay + totalDroppedDup
+                       + totalDroppedDedupFull + totalDroppedQueue + totalDroppedBattery;
+        // پیام‌های دستهٔ ناتمام، منتظر در صف یا در حال سرویس (پذیرفته‌شده) در پایان شبیه‌سازی
+        // نه پذیرفته شده‌اند نه حذف
+        int inService = 0;
+        for (cMessage* t : coreTimers) if (t->getContextPointer()) inService++;
+        int pending = (int)batch.size() + (int)waitQueue.size() + inService;
+        if (inReceived != (totalAccepted + totalDrops + pending)) mismatchCounter++;
 
         // goodput = totalAccepted / duration
         double duration = SIMTIME_DBL(simTime());
         double goodput = (duration > 0) ? ((double)totalAccepted / duration) : 0.0;
 
         // Bloom/SBF مقادیر خلاصه
-        double bloomFP = (bloomQueries > 0) ? ((double)bloomFalsePos / (double)bloomQueries) : 0.0;
+        double bloomFP = oracle.estimate();
+        double bloomFPLo = 0, bloomFPHi = 0;
+        oracle.confidence95(bloomFPLo, bloomFPHi);
+        // FP مدل تحلیلی برای مقایسه با bloomFP تجربی (bloom در برابر blocked_bloom)
+        double bloomFPModel = -1.0;
+        if (duplicateMethod == "bloom" && bloomInserts > 0)
+            bloomFPModel = std::pow(1.0 - std::exp(-(double)bloomHashes * (double)bloomInserts / (double)bloomBits), (double)bloomHashes);
+        else if (duplicateMethod == "blocked_bloom")
+            bloomFPModel = blockedBloom.expectedFp(bloomInserts);
         double callsPerK = (inReceived > 0) ? (1000.0 * (double)bloomQueries / (double)inReceived) : 0.0;
 
         // انرژی
@@ -390,32 +1298,218 @@ class GatewayNode : public cSimpleModule {
 
         // Workavg برحسب «تعداد اجرای مراحل» (مقایسه‌ی ترتیبی)
         double workAvg_units = (inReceived > 0)
-            ? ((double)(workH_checks + workF_checks + workB_checks) / (double)inReceived)
+            ? ((double)(workP_checks + workH_checks + workF_checks + workB_checks) / (double)inReceived)
             : 0.0;
 
         // ==== Scalars (نام‌ها مطابق پایان‌نامه) ====
         recordScalar("totalAccepted", totalAccepted);
+        recordScalar("totalDroppedPrecheck", totalDroppedPrecheck);
         recordScalar("totalDroppedHmac", totalDroppedHmac);
         recordScalar("totalDroppedReplay", totalDroppedReplay);
         recordScalar("totalDroppedDup", totalDroppedDup);
+        recordScalar("totalDroppedDedupFull", totalDroppedDedupFull);
+        if (verifierCores > 0) recordScalar("totalDroppedQueue", totalDroppedQueue);
+        if (verifierCores > 0 || batchSize > 1) recordScalar("totalDroppedBattery", totalDroppedBattery);
         recordScalar("goodput", goodput);
+        recordScalar("goodputBytes", (duration > 0) ? ((double)txBytes / duration) : 0.0);
+        recordScalar("tagBytes", tagBytes);
+        recordScalar("rxBytes", (double)rxBytes);
 
-        recordScalar("bloomFP", bloomFP);
+        // bloomFP همیشه (مانند قبل از oracle): بدون oracle یا بدون پرس‌وجوی تقریبی (set/flatset) برابر 0
+        recordScalar("bloomFP", oracle.enabled() ? bloomFP : 0.0);
+        recordScalar("fpOracleEnabled", oracle.enabled() ? 1.0 : 0.0);
+        if (oracle.enabled()) {
+            recordScalar("bloomFP_ciLow", bloomFPLo);
+            recordScalar("bloomFP_ciHigh", bloomFPHi);
+            recordScalar("fpOracleRate", oracle.rate());
+            recordScalar("fpOracleQueries", (double)oracle.queries());
+            recordScalar("fpOracleBytes", (double)oracle.memoryBytes());
+        }
+        if (bloomFPModel >= 0) recordScalar("bloomFP_model", bloomFPModel);
+        if (duplicateMethod == "blocked_bloom") {
+            recordScalar("blockedBloomBlocks", (double)blockedBloom.blocks());
+            recordScalar("blockedBloomBytes", (double)blockedBloom.memoryBytes());
+        }
         recordScalar("bloomCallsPerK", callsPerK);
         recordScalar("bloomQueriesTotal", (double)bloomQueries);
         recordScalar("bloomInsertsTotal", (double)bloomInserts);
 
+        if (duplicateMethod == "flatset") {
+            recordScalar("flatsetCapacity", (double)flatSet.capacity());
+            recordScalar("flatsetOccupancy", flatSet.occupancy());
+            recordScalar("flatsetMaxOccupancy", flatSet.maxOccupancy);
+            recordScalar("flatsetAvgProbe", flatSet.lookups > 0 ? (double)flatSet.probesTotal / (double)flatSet.lookups : 0.0);
+            recordScalar("flatsetMaxProbe", (double)flatSet.maxProbe);
+            recordScalar("flatsetExpired", (double)flatSet.expired);
+            recordScalar("flatsetInsertFail", (double)flatSet.insertFail);
+            recordScalar("flatsetBytes", (double)flatSet.memoryBytes());
+        }
+        if (duplicateMethod == "aged_bloom") {
+            recordScalar("agedBloomGenerations", (double)agedBloom.generations());
+            recordScalar("agedBloomSlice_s", (double)agedBloom.slice() * 1e-6);
+            recordScalar("agedBloomRollovers", (double)agedBloom.rollovers);
+            recordScalar("agedBloomBytes", (double)agedBloom.memoryBytes());
+        }
+        if (duplicateMethod == "sbf") {
+            recordScalar("sbfCounters", (double)sbf.counters());
+            recordScalar("sbfBytes", (double)sbf.memoryBytes());
+            recordScalar("sbfDecayedCells", (double)sbf.decayedCells);
+            recordScalar("sbfSaturated", (double)sbf.saturated);
+        }
+        if (duplicateMethod == "cuckoo") {
+            cuckoo.purge(ts_to_us(simTime()));   // ضریب بار فقط برای IDهای داخل پنجره
+            recordScalar("cuckooCapacity", (double)cuckoo.capacity());
+            recordScalar("cuckooFpBits", (double)cuckoo.fpBits());
+            recordScalar("cuckooBucketSize", (double)cuckoo.bucketSize());
+            recordScalar("cuckooLoadFactor", cuckoo.loadFactor());
+            recordScalar("cuckooMaxLoadFactor", cuckoo.maxLoadFactor);
+            recordScalar("cuckooKicksTotal", (double)cuckoo.kicksTotal);
+            recordScalar("cuckooKicksPerInsert", cuckoo.inserts > 0 ? (double)cuckoo.kicksTotal / (double)cuckoo.inserts : 0.0);
+            recordScalar("cuckooMaxKicks", (double)cuckoo.maxKicks);
+            recordScalar("cuckooInsertFail", (double)cuckoo.insertFail);
+            recordScalar("cuckooExpired", (double)cuckoo.expired);
+            recordScalar("cuckooBytes", (double)cuckoo.memoryBytes());
+        }
+
         recordScalar("energyGW_mJ", energyGW_mJ);
         recordScalar("energyPerMsg_mJ", energyPerMsg_mJ);
+        recordScalar("energyPrecheck_mJ", energyP);
+        // انرژی بررسی به تفکیک مرحله (مدل stage) یا ثابت (مدل flat)
+        // (دسته‌ای: به‌علاوهٔ هزینهٔ دسته‌ها)
+        double energyVerify = (stageEnergy ? energyP + energyH + energyF + energyB : energyVerifyFlat) + batchEnergy;
+        recordScalar("energyStageModel", stageEnergy ? 1.0 : 0.0);
+        if (stageEnergy) {
+            recordScalar("energyH_mJ", energyH);
+            recordScalar("energyF_mJ", energyF);
+            recordScalar("energyB_mJ", energyB);
+            recordScalar("costB_mJ", costB);
+        }
+        recordScalar("energyVerify_mJ", energyVerify);
+        recordScalar("energyVerifyPerMsg_mJ", inReceived > 0 ? energyVerify / (double)inReceived : 0.0);
 
         recordScalar("workAvg_units", workAvg_units);
+        recordScalar("workP_count", (double)workP_checks);
         recordScalar("workH_count", (double)workH_checks);
         recordScalar("workF_count", (double)workF_checks);
         recordScalar("workB_count", (double)workB_checks);
 
+        if (perSensorKeys) {
+            long lookups = keyCache.hits + keyCache.misses;
+            recordScalar("keyCacheHits", (double)keyCache.hits);
+            recordScalar("keyCacheMisses", (double)keyCache.misses);
+            recordScalar("keyCacheEvictions", (double)keyCache.evictions);
+            recordScalar("keyCacheHitRate", lookups > 0 ? (double)keyCache.hits / (double)lookups : 0.0);
+            recordScalar("keyCacheCapacity", (double)keyCache.capacity());
+            recordScalar("keyCacheBytes", (double)keyCache.memoryBytes());
+        }
+
+        if (checkFreshness) {
+            recordScalar("freshDenseSources", (double)freshTable.denseSize());
+            recordScalar("freshOverflowCapacity", (double)freshTable.overflowCapacity());
+            recordScalar("freshOverflowInserts", (double)freshTable.overflowInserts);
+            recordScalar("freshOverflowEvictions", (double)freshTable.evictions);
+            recordScalar("freshOverflowDrops", (double)freshTable.drops);
+            // حافظهٔ بیت‌مپ حلقوی بیرون از FreshState (کران بالا: هر منبع موجود یک حلقه)
+            double ringBytes = replayWindow > 64
+                ? (double)(freshTable.denseSize() + freshTable.overflowSize()) * (double)(replayWindow / 8) : 0.0;
+            double freshBytes = (double)freshTable.memoryBytes() + ringBytes;
+            recordScalar("replayWindow", (double)replayWindow);
+            recordScalar("freshBytes", freshBytes);
+            recordScalar("freshBytesPerSensor", freshBytes / (double)std::max(1, shardSensors));
+        }
+
+        if (adaptiveOrder) {
+            recordScalar("adaptiveReorders", (double)reorderEvents);
+            recordScalar("adaptiveSamples", (double)adaptiveSamples);
+            recordScalar("adaptiveRejectH", stageWin[0].rejectRate());
+            recordScalar("adaptiveRejectF", stageWin[1].rejectRate());
+            recordScalar("adaptiveRejectB", stageWin[2].rejectRate());
+            recordScalar("adaptiveRejectP", stageWin[3].rejectRate());
+            recordScalar("adaptiveCostH", stageCost(0));
+            recordScalar("adaptiveCostF", stageCost(1));
+            recordScalar("adaptiveCostB", stageCost(2));
+            recordScalar("adaptiveCostP", stageCost(3));
+            recordScalar("adaptiveExpectedWork", expectedWork(orderId));
+        }
+
+        if (batchSize > 1) {
+            recordScalar("batchSizeMax", (double)batchSize);
+            recordScalar("batchTimeout_s", SIMTIME_DBL(batchTimeout));
+            recordScalar("batches", (double)batches);
+            recordScalar("batchTimeoutFlushes", (double)batchTimeoutFlushes);
+            recordScalar("batchSizeAvg", batches > 0 ? (double)batchMessages / (double)batches : 0.0);
+            recordScalar("batchWaitAvg_s", batchMessages > 0 ? batchWaitSum / (double)batchMessages : 0.0);
+            recordScalar("batchWaitMax_s", batchWaitMax);
+            recordScalar("batchThroughput", duration > 0 ? (double)batchMessages / duration : 0.0);
+            recordScalar("batchEnergy_mJ", batchEnergy);
+            recordScalar("batchPending", (double)batch.size());
+        }
+
+        if (verifierCores > 0) {
+            noteQueueState();
+            recordScalar("verifierCores", (double)verifierCores);
+            recordScalar("bufferSize", (double)bufferSize);
+            recordScalar("queueLenAvg", duration > 0 ? queueArea / duration : 0.0);
+            recordScalar("queueLenMax", (double)queueLenMax);
+            recordScalar("queueWaitAvg_s", served > 0 ? queueWaitSum / (double)served : 0.0);
+            recordScalar("queueWaitMax_s", queueWaitMax);
+            recordScalar("serviceTimeAvg_s", served > 0 ? serviceSum / (double)served : 0.0);
+            recordScalar("coreUtilization", duration > 0 ? busyArea / (duration * (double)verifierCores) : 0.0);
+            recordScalar("queueDropRate", inReceived > 0 ? (double)totalDroppedQueue / (double)inReceived : 0.0);
+            recordScalar("queuePending", (double)(waitQueue.size() + inService));
+        }
+
+        if (shardIndex >= 0) {
+            recordScalar("shardIndex", (double)shardIndex);
+            recordScalar("shardSensors", (double)shardSensors);
+            // شارد 0 عدم توازن کل را ثبت می‌کند (بار = پیام‌های دریافتی هر شارد)
+            cModule* net = getParentModule();
+            if (shardIndex == 0) {
+                double maxLoad = 0, sumLoad = 0, sumSq = 0, maxSensors = 0, sumSensors = 0;
+                for (int k = 0; k < numGateways; ++k) {
+                    auto* gw = check_and_cast<GatewayNode*>(net->getSubmodule(getName(), k));
+                    double load = (double)gw->inReceived;
+                    maxLoad = std::max(maxLoad, load);
+                    sumLoad += load;
+                    sumSq += load * load;
+                    maxSensors = std::max(maxSensors, (double)gw->shardSensors);
+                    sumSensors += (double)gw->shardSensors;
+                }
+                double meanLoad = sumLoad / (double)numGateways;
+                double meanSensors = sumSensors / (double)numGateways;
+                recordScalar("numGateways", (double)numGateways);
+                recordScalar("shardLoadImbalance", meanLoad > 0 ? maxLoad / meanLoad : 0.0);   // max/mean
+                recordScalar("shardLoadCV", meanLoad > 0
+                    ? std::sqrt(std::max(0.0, sumSq / (double)numGateways - meanLoad * meanLoad)) / meanLoad : 0.0);
+                recordScalar("shardSensorImbalance", meanSensors > 0 ? maxSensors / meanSensors : 0.0);
+            }
+        }
+
         recordScalar("stageOrderId", (double)orderId);
         recordScalar("mismatchCounter", mismatchCounter);
     }
+
+  public:
+    virtual ~GatewayNode(){
+        cancelAndDelete(batchTimer);
+        for (LightIoTMessage* m : batch) delete m;
+        for (LightIoTMessage* m : waitQueue) delete m;
+        for (cMessage* t : coreTimers) {
+            delete static_cast<LightIoTMessage*>(t->getContextPointer());
+            cancelAndDelete(t);
+        }
+    }
 };
 
 Define_Module(GatewayNode);
+
+// NED: index of the gateway shard that owns a sensor (same ring as GatewayNode)
+static cValue lightiotShardOf(cComponent*, cValue argv[], int)
+{
+    static ShardRing ring;
+    int gateways = (int)argv[1].intValue(), vnodes = (int)argv[2].intValue();
+    if (ring.gateways() != std::max(1, gateways) || ring.vnodes() != std::max(1, vnodes)) ring.init(gateways, vnodes);
+    return (intval_t)ring.shardOf((int)argv[0].intValue());
+}
+Define_NED_Function2(lightiotShardOf, "int lightiotShardOf(int sensor, int gateways, int vnodes)", "LightIoT",
+                     "consistent-hash gateway shard of a sensor index");
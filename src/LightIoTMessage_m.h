@@ -1,25 +1,44 @@
 #pragma once
 #include <omnetpp.h>
+#include <array>
+#include <climits>
+#include <cstdint>
+#include <cstring>
 #include <string>
+#include "crypto/crypto_utils.h"
 
 using namespace omnetpp;
 
-class LightIoTMessage : public cMessage {
+// cPacket so the wire size (header + tag) is visible to channels and energy models
+class LightIoTMessage : public cPacket {
+  public:
+    static const size_t MAC_MAX = 16;
+    static const int HEADER_BYTES = 20;    // id(4) + src(4) + seq(4) + timestamp(8)
+    static const int ID_STRIDE = 100000;   // SensorNode: id = (src+1)*stride + seq, stride = idStrideFor(N)
+    // id is 32-bit: beyond ~21k sensors the stride shrinks so (N+1)*stride fits in an int
+    static int idStrideFor(int numSensors) {
+        if (numSensors < 1) return ID_STRIDE;
+        int s = INT_MAX / (numSensors + 1);
+        return s < ID_STRIDE ? s : ID_STRIDE;
+    }
+    // tag lengths allowed by tagBytes (truncated CMAC, SP 800-38B)
+    static bool isValidTagBytes(int n) { return n==4 || n==8 || n==12 || n==16; }
   private:
     int id_ = 0;
     int src_ = 0;
     int seq_ = 0;
     simtime_t ts_;
-    std::string macHex_;
+    std::array<uint8_t, MAC_MAX> mac_{};   // binary MAC tag; only the first macLen_ bytes are valid
+    uint8_t macLen_ = 0;                   // 0 = no tag (NoSecurity / malformed)
     void copy(const LightIoTMessage& o) {
         id_ = o.id_; src_ = o.src_; seq_ = o.seq_;
-        ts_ = o.ts_; macHex_ = o.macHex_;
+        ts_ = o.ts_; mac_ = o.mac_; macLen_ = o.macLen_;
     }
   public:
-    LightIoTMessage(const char* name=nullptr) : cMessage(name) {}
-    LightIoTMessage(const LightIoTMessage& o) : cMessage(o) { copy(o); }
+    LightIoTMessage(const char* name=nullptr) : cPacket(name) { setByteLength(HEADER_BYTES); }
+    LightIoTMessage(const LightIoTMessage& o) : cPacket(o) { copy(o); }
     LightIoTMessage& operator=(const LightIoTMessage& o) {
-        if (this==&o) return *this; cMessage::operator=(o); copy(o); return *this;
+        if (this==&o) return *this; cPacket::operator=(o); copy(o); return *this;
     }
     virtual LightIoTMessage* dup() const override { return new LightIoTMessage(*this); }
 
@@ -27,5 +46,15 @@ class LightIoTMessage : public cMessage {
     void setSrc(int v){ src_ = v; }         int getSrc() const { return src_; }
     void setSeq(int v){ seq_ = v; }         int getSeq() const { return seq_; }
     void setTimestamp(simtime_t t){ ts_ = t; } simtime_t getTimestamp() const { return ts_; }
-    void setMacHex(const std::string& s){ macHex_ = s; } const std::string& getMacHex() const { return macHex_; }
+
+    // MAC tag (zero-copy); len > MAC_MAX is rejected as "no tag".
+    // byteLength follows the tag: HEADER_BYTES + macLen
+    void setMac(const uint8_t* p, size_t len) {
+        if (!p || len > MAC_MAX) { clearMac(); return; }
+        std::memcpy(mac_.data(), p, len); macLen_ = (uint8_t)len;
+        setByteLength(HEADER_BYTES + macLen_);
+    }
+    void clearMac() { macLen_ = 0; setByteLength(HEADER_BYTES); }
+    const uint8_t* getMac() const { return mac_.data(); }
+    size_t getMacLen() const { return macLen_; }
 };
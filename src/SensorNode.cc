@@ -15,14 +15,18 @@ class SensorNode : public cSimpleModule {
     cMessage *sendEvent = nullptr;
     int seq = 0;
     int baseId = 0;
+    int idStride = LightIoTMessage::ID_STRIDE;   // seq در [1, idStride)
 
-    std::string aesKeyHex;
-    std::string mode; // "Secure" | "NoSecurity" | "Replay"
+    CmacContext cmac;
+    bool noSecurity = false;  // mode == "NoSecurity" (Secure | NoSecurity | Replay)
+    int tagBytes = 16;  // طول تگ CMAC کوتاه‌شده: 4/8/12/16
     simtime_t sendInterval = 0.5;
 
     // انرژی مدل ساده (اختیاری)
     double batteryCapacity = 5000.0;
     double consumptionPerMessage = 20.0;
+    double txCostPerByte = 0.0;   // هزینه رادیو به ازای هر بایت ارسالی
+    long   txBytes = 0;
 
     inline int64_t now_us() const {
         return (int64_t) llround(SIMTIME_DBL(simTime()) * 1e6);
@@ -30,20 +34,49 @@ class SensorNode : public cSimpleModule {
 
   protected:
     virtual void initialize() override {
-        baseId = (getIndex() + 1) * 100000;
-        aesKeyHex = par("aesKeyHex").stdstringValue();
-        mode = par("mode").stdstringValue();
+        // فاصلهٔ شناسه‌ها از تعداد سنسورهای شبکه (id باید در int جا شود)
+        cModule* net = getParentModule();
+        idStride = LightIoTMessage::idStrideFor(
+            (net && net->hasPar("numSensorNodes")) ? (int)net->par("numSensorNodes").intValue() : 0);
+        baseId = (getIndex() + 1) * idStride;
+        std::string aesKeyHex = par("aesKeyHex").stdstringValue();
+        noSecurity = par("mode").stdstringValue() == "NoSecurity";
         sendInterval = par("sendInterval");
+        tagBytes = par("tagBytes").intValue();
+        if (!LightIoTMessage::isValidTagBytes(tagBytes)) {
+            EV << "[SensorNode] Invalid tagBytes " << tagBytes << "; using 16.\n";
+            tagBytes = 16;
+        }
+        txCostPerByte = par("txCostPerByte_mJ").doubleValue();
+
+        std::vector<uint8_t> keyBytes;
+        if (!hexToBytes(aesKeyHex, keyBytes) || keyBytes.size()!=16) {
+            EV << "[SensorNode] Invalid aesKeyHex; expected 16-byte hex.\n";
+            keyBytes.assign(16, 0);
+        }
+        cmac.init(keyBytes.data());
+        if (par("perSensorKeys").boolValue()) {
+            // K_src = KDF(master, src)؛ Gateway همین را از کلید اصلی می‌سازد
+            uint8_t k[16];
+            cmacDeriveSensorKey(cmac, getIndex(), k);
+            cmac.init(k);
+        }
 
         sendEvent = new cMessage("sendEvent");
         scheduleAt(simTime() + uniform(0.5, 1.5), sendEvent);
     }
 
     virtual void handleMessage(cMessage *msg) override {
-        if (batteryCapacity < consumptionPerMessage) {
+        int wireBytes = LightIoTMessage::HEADER_BYTES + (noSecurity ? 0 : tagBytes);
+        double need = consumptionPerMessage + txCostPerByte * wireBytes;
+        if (batteryCapacity < need) {
             EV << "[SensorNode] Battery depleted. Node stopped.\n";
             delete msg; sendEvent = nullptr; return;
         }
+        if (seq + 1 >= idStride) {
+            EV << "[SensorNode] Sequence space exhausted (" << idStride << "). Node stopped.\n";
+            delete msg; sendEvent = nullptr; return;
+        }
 
         auto *packet = new LightIoTMessage("SensorData");
         int id = baseId + (++seq);
@@ -55,28 +88,23 @@ class SensorNode : public cSimpleModule {
         packet->setTimestamp(SimTime(ts_us, SIMTIME_US));
 
         // اگر NoSecurity باشد، MAC را خالی می‌گذاریم
-        if (mode == "NoSecurity") {
-            packet->setMacHex("");
+        if (noSecurity) {
+            packet->clearMac();
         } else {
-            std::vector<uint8_t> keyBytes;
-            if (!hexToBytes(aesKeyHex, keyBytes) || keyBytes.size()!=16) {
-                EV << "[SensorNode] Invalid aesKeyHex; expected 16-byte hex.\n";
-                keyBytes.assign(16, 0);
-            }
-            std::vector<uint8_t> mbytes;
-            packIdTsBigEndian(id, ts_us, mbytes);
             uint8_t tag[16];
-            aes128_cmac(keyBytes.data(), mbytes.data(), mbytes.size(), tag);
-            packet->setMacHex(bytesToHex(tag, 16));
+            cmacIdTs(cmac, id, ts_us, tag);
+            packet->setMac(tag, tagBytes); // تگ کوتاه‌شده = tagBytes بایت اول
         }
 
+        txBytes += packet->getByteLength();
         send(packet, "out");
-        batteryCapacity -= consumptionPerMessage;
+        batteryCapacity -= need;
         scheduleAt(simTime() + uniform(SIMTIME_DBL(sendInterval)*0.9, SIMTIME_DBL(sendInterval)*1.1), sendEvent);
     }
 
     virtual void finish() override {
         recordScalar("Sensor_EnergyRemaining_mJ", batteryCapacity);
+        recordScalar("Sensor_TxBytes", (double)txBytes);
         if (sendEvent) { cancelAndDelete(sendEvent); sendEvent=nullptr; }
     }
 };
@@ -0,0 +1,34 @@
+// /src/crypto/aes_backend.h
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Raw AES-128 block encryption over a 176-byte key schedule (11 round keys in
+// FIPS-197 byte order, as produced by tiny-AES KeyExpansion). All backends
+// share this layout, so one CmacContext works with whichever is selected.
+//
+// Backend selection happens once at startup:
+//   - AES-NI when CPUID reports it (x86/x86-64 only),
+//   - otherwise the portable 32-bit T-table implementation.
+// Build flags override the CPUID check:
+//   -DLIGHTIOT_AES_FORCE_AESNI   always AES-NI (faults on CPUs without it)
+//   -DLIGHTIOT_AES_FORCE_TTABLE  always T-table
+//   -DLIGHTIOT_AES_FORCE_TINY    always byte-oriented tiny-AES (reference)
+
+typedef void (*Aes128EncryptFn)(const uint8_t roundKey[176], uint8_t block[16]);
+typedef void (*Aes128EncryptManyFn)(const uint8_t roundKey[176], uint8_t* blocks, size_t n);
+
+void aes128_expand_key(const uint8_t key[16], uint8_t roundKey[176]);
+
+// Dispatching entry point (backend picked at startup).
+void aes128_encrypt_block(const uint8_t roundKey[176], uint8_t block[16]);
+// n independent blocks (ECB) stored back to back; AES-NI keeps up to 8 in flight.
+void aes128_encrypt_blocks(const uint8_t roundKey[176], uint8_t* blocks, size_t n);
+const char* aes128_backend_name();
+
+// Individual backends (for cross-checks and benchmarks).
+void aes128_encrypt_block_tiny(const uint8_t roundKey[176], uint8_t block[16]);
+void aes128_encrypt_block_ttable(const uint8_t roundKey[176], uint8_t block[16]);
+void aes128_encrypt_block_aesni(const uint8_t roundKey[176], uint8_t block[16]);
+void aes128_encrypt_blocks_aesni(const uint8_t roundKey[176], uint8_t* blocks, size_t n);
+bool aes128_aesni_available();
@@ -0,0 +1,67 @@
+// /src/crypto/aes_dispatch.cc
+// Picks the AES block backend once at startup (see aes_backend.h).
+#include "aes_backend.h"
+
+namespace {
+
+template <Aes128EncryptFn One>
+void encryptManyLoop(const uint8_t roundKey[176], uint8_t* blocks, size_t n) {
+    for (size_t i = 0; i < n; ++i) One(roundKey, blocks + 16*i);
+}
+
+struct AesBackendChoice {
+    Aes128EncryptFn fn;
+    Aes128EncryptManyFn many;
+    const char* name;
+};
+
+AesBackendChoice pickBackend() {
+#if defined(LIGHTIOT_AES_FORCE_AESNI)
+    return { aes128_encrypt_block_aesni, aes128_encrypt_blocks_aesni, "aesni(forced)" };
+#elif defined(LIGHTIOT_AES_FORCE_TTABLE)
+    return { aes128_encrypt_block_ttable, encryptManyLoop<aes128_encrypt_block_ttable>, "ttable(forced)" };
+#elif defined(LIGHTIOT_AES_FORCE_TINY)
+    return { aes128_encrypt_block_tiny, encryptManyLoop<aes128_encrypt_block_tiny>, "tiny(forced)" };
+#else
+    if (aes128_aesni_available())
+        return { aes128_encrypt_block_aesni, aes128_encrypt_blocks_aesni, "aesni" };
+    return { aes128_encrypt_block_ttable, encryptManyLoop<aes128_encrypt_block_ttable>, "ttable" };
+#endif
+}
+
+void resolveOne(const uint8_t roundKey[176], uint8_t block[16]);
+void resolveMany(const uint8_t roundKey[176], uint8_t* blocks, size_t n);
+
+// Constant-initialised to resolving stubs, so a call that happens before
+// this TU's dynamic initialisation still lands on a real backend.
+AesBackendChoice g_backend = { resolveOne, resolveMany, nullptr };
+
+const AesBackendChoice& backend() {
+    if (!g_backend.name) g_backend = pickBackend();
+    return g_backend;
+}
+
+void resolveOne(const uint8_t roundKey[176], uint8_t block[16]) {
+    backend().fn(roundKey, block);
+}
+
+void resolveMany(const uint8_t roundKey[176], uint8_t* blocks, size_t n) {
+    backend().many(roundKey, blocks, n);
+}
+
+// Pick at startup.
+const bool g_picked = (backend(), true);
+
+} // namespace
+
+void aes128_encrypt_block(const uint8_t roundKey[176], uint8_t block[16]) {
+    g_backend.fn(roundKey, block);
+}
+
+void aes128_encrypt_blocks(const uint8_t roundKey[176], uint8_t* blocks, size_t n) {
+    g_backend.many(roundKey, blocks, n);
+}
+
+const char* aes128_backend_name() {
+    return backend().name;
+}
@@ -1,5 +1,16 @@
 // /src/crypto/aes_link.cc
+#include "aes_backend.h"
 
 extern "C" {
 #include "aes.c"
 }
+
+// Raw key-schedule entry points: the expanded key lives in a plain 176-byte
+// array instead of struct AES_ctx, so every backend can share it.
+void aes128_expand_key(const uint8_t key[16], uint8_t roundKey[176]) {
+    KeyExpansion(roundKey, key);
+}
+
+void aes128_encrypt_block_tiny(const uint8_t roundKey[176], uint8_t block[16]) {
+    Cipher((state_t*)block, roundKey);
+}
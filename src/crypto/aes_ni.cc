@@ -0,0 +1,81 @@
+// /src/crypto/aes_ni.cc
+// AES-128 encryption with the x86 AES-NI instructions. Compiled with a
+// function-level target attribute, so the rest of the build does not need
+// -maes; aes128_aesni_available() must be checked before calling.
+#include "aes_backend.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define LIGHTIOT_HAVE_AESNI 1
+#include <cpuid.h>
+#include <wmmintrin.h>
+#include <emmintrin.h>
+#endif
+
+#ifdef LIGHTIOT_HAVE_AESNI
+
+bool aes128_aesni_available() {
+    unsigned a = 0, b = 0, c = 0, d = 0;
+    if (!__get_cpuid(1, &a, &b, &c, &d)) return false;
+    return (c & bit_AES) != 0;
+}
+
+__attribute__((target("aes,sse2")))
+void aes128_encrypt_block_aesni(const uint8_t roundKey[176], uint8_t block[16]) {
+    const __m128i* rk = (const __m128i*)roundKey;
+    __m128i s = _mm_loadu_si128((const __m128i*)block);
+    s = _mm_xor_si128(s, _mm_loadu_si128(rk + 0));
+    for (int r = 1; r < 10; ++r)
+        s = _mm_aesenc_si128(s, _mm_loadu_si128(rk + r));
+    s = _mm_aesenclast_si128(s, _mm_loadu_si128(rk + 10));
+    _mm_storeu_si128((__m128i*)block, s);
+}
+
+// Eight independent states per round so the aesenc latency is hidden
+// behind the other lanes; the tail goes one block at a time.
+__attribute__((target("aes,sse2")))
+void aes128_encrypt_blocks_aesni(const uint8_t roundKey[176], uint8_t* blocks, size_t n) {
+    const __m128i* rk = (const __m128i*)roundKey;
+    __m128i k[11];
+    for (int r = 0; r < 11; ++r) k[r] = _mm_loadu_si128(rk + r);
+
+#define AESNI_LANES8(op, key) \
+    s0 = op(s0, key); s1 = op(s1, key); s2 = op(s2, key); s3 = op(s3, key); \
+    s4 = op(s4, key); s5 = op(s5, key); s6 = op(s6, key); s7 = op(s7, key);
+
+    __m128i* p = (__m128i*)blocks;
+    for (; n >= 8; n -= 8, p += 8) {
+        __m128i s0 = _mm_loadu_si128(p + 0), s1 = _mm_loadu_si128(p + 1);
+        __m128i s2 = _mm_loadu_si128(p + 2), s3 = _mm_loadu_si128(p + 3);
+        __m128i s4 = _mm_loadu_si128(p + 4), s5 = _mm_loadu_si128(p + 5);
+        __m128i s6 = _mm_loadu_si128(p + 6), s7 = _mm_loadu_si128(p + 7);
+        AESNI_LANES8(_mm_xor_si128, k[0])
+        for (int r = 1; r < 10; ++r) { AESNI_LANES8(_mm_aesenc_si128, k[r]) }
+        AESNI_LANES8(_mm_aesenclast_si128, k[10])
+        _mm_storeu_si128(p + 0, s0); _mm_storeu_si128(p + 1, s1);
+        _mm_storeu_si128(p + 2, s2); _mm_storeu_si128(p + 3, s3);
+        _mm_storeu_si128(p + 4, s4); _mm_storeu_si128(p + 5, s5);
+        _mm_storeu_si128(p + 6, s6); _mm_storeu_si128(p + 7, s7);
+    }
+#undef AESNI_LANES8
+
+    for (; n > 0; --n, ++p) {
+        __m128i s = _mm_xor_si128(_mm_loadu_si128(p), k[0]);
+        for (int r = 1; r < 10; ++r) s = _mm_aesenc_si128(s, k[r]);
+        _mm_storeu_si128(p, _mm_aesenclast_si128(s, k[10]));
+    }
+}
+
+#else
+
+bool aes128_aesni_available() { return false; }
+
+void aes128_encrypt_block_aesni(const uint8_t roundKey[176], uint8_t block[16]) {
+    // no AES-NI on this target; never selected by the dispatcher
+    aes128_encrypt_block_ttable(roundKey, block);
+}
+
+void aes128_encrypt_blocks_aesni(const uint8_t roundKey[176], uint8_t* blocks, size_t n) {
+    for (size_t i = 0; i < n; ++i) aes128_encrypt_block_ttable(roundKey, blocks + 16*i);
+}
+
+#endif
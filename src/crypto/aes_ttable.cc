@@ -0,0 +1,100 @@
+// /src/crypto/aes_ttable.cc
+// Portable AES-128 encryption with 32-bit T-tables (SubBytes+ShiftRows+
+// MixColumns folded into four 1 KiB lookups per column per round).
+// Tables are generated at compile time from the GF(2^8) definition.
+#include "aes_backend.h"
+#include <array>
+
+namespace {
+
+constexpr uint8_t gmul2(uint8_t x) {
+    return (uint8_t)((x << 1) ^ ((x & 0x80) ? 0x1b : 0x00));
+}
+
+constexpr uint8_t gmul(uint8_t a, uint8_t b) {
+    uint8_t p = 0;
+    for (int i = 0; i < 8; ++i) {
+        if (b & 1) p ^= a;
+        a = gmul2(a);
+        b >>= 1;
+    }
+    return p;
+}
+
+constexpr uint8_t rotl8(uint8_t x, int s) {
+    return (uint8_t)((x << s) | (x >> (8 - s)));
+}
+
+constexpr std::array<uint8_t, 256> makeSbox() {
+    std::array<uint8_t, 256> s{};
+    for (int x = 0; x < 256; ++x) {
+        // multiplicative inverse (0 -> 0), then the affine transform
+        uint8_t inv = 0;
+        for (int y = 1; y < 256 && x != 0; ++y) {
+            if (gmul((uint8_t)x, (uint8_t)y) == 1) { inv = (uint8_t)y; break; }
+        }
+        s[x] = (uint8_t)(inv ^ rotl8(inv, 1) ^ rotl8(inv, 2) ^ rotl8(inv, 3) ^ rotl8(inv, 4) ^ 0x63);
+    }
+    return s;
+}
+
+constexpr uint32_t ror32(uint32_t x, int s) {
+    return (x >> s) | (x << (32 - s));
+}
+
+constexpr std::array<uint8_t, 256> kSbox = makeSbox();
+
+constexpr std::array<uint32_t, 256> makeTe(int rot) {
+    std::array<uint32_t, 256> t{};
+    for (int x = 0; x < 256; ++x) {
+        uint8_t s = kSbox[x];
+        uint32_t w = ((uint32_t)gmul2(s) << 24) | ((uint32_t)s << 16) |
+                     ((uint32_t)s << 8) | (uint32_t)(uint8_t)(gmul2(s) ^ s);
+        t[x] = rot ? ror32(w, rot) : w;
+    }
+    return t;
+}
+
+constexpr std::array<uint32_t, 256> Te0 = makeTe(0);
+constexpr std::array<uint32_t, 256> Te1 = makeTe(8);
+constexpr std::array<uint32_t, 256> Te2 = makeTe(16);
+constexpr std::array<uint32_t, 256> Te3 = makeTe(24);
+
+inline uint32_t load_be32(const uint8_t* p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+inline void store_be32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)(v >> 24); p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);  p[3] = (uint8_t)v;
+}
+
+} // namespace
+
+void aes128_encrypt_block_ttable(const uint8_t roundKey[176], uint8_t block[16]) {
+    uint32_t s0 = load_be32(block + 0)  ^ load_be32(roundKey + 0);
+    uint32_t s1 = load_be32(block + 4)  ^ load_be32(roundKey + 4);
+    uint32_t s2 = load_be32(block + 8)  ^ load_be32(roundKey + 8);
+    uint32_t s3 = load_be32(block + 12) ^ load_be32(roundKey + 12);
+
+    for (int r = 1; r < 10; ++r) {
+        const uint8_t* rk = roundKey + 16 * r;
+        uint32_t t0 = Te0[s0 >> 24] ^ Te1[(s1 >> 16) & 0xff] ^ Te2[(s2 >> 8) & 0xff] ^ Te3[s3 & 0xff] ^ load_be32(rk + 0);
+        uint32_t t1 = Te0[s1 >> 24] ^ Te1[(s2 >> 16) & 0xff] ^ Te2[(s3 >> 8) & 0xff] ^ Te3[s0 & 0xff] ^ load_be32(rk + 4);
+        uint32_t t2 = Te0[s2 >> 24] ^ Te1[(s3 >> 16) & 0xff] ^ Te2[(s0 >> 8) & 0xff] ^ Te3[s1 & 0xff] ^ load_be32(rk + 8);
+        uint32_t t3 = Te0[s3 >> 24] ^ Te1[(s0 >> 16) & 0xff] ^ Te2[(s1 >> 8) & 0xff] ^ Te3[s2 & 0xff] ^ load_be32(rk + 12);
+        s0 = t0; s1 = t1; s2 = t2; s3 = t3;
+    }
+
+    // Final round: SubBytes + ShiftRows only
+    const uint8_t* rk = roundKey + 160;
+    const auto& S = kSbox;
+    store_be32(block + 0,  (((uint32_t)S[s0 >> 24] << 24) | ((uint32_t)S[(s1 >> 16) & 0xff] << 16) |
+                            ((uint32_t)S[(s2 >> 8) & 0xff] << 8) | (uint32_t)S[s3 & 0xff]) ^ load_be32(rk + 0));
+    store_be32(block + 4,  (((uint32_t)S[s1 >> 24] << 24) | ((uint32_t)S[(s2 >> 16) & 0xff] << 16) |
+                            ((uint32_t)S[(s3 >> 8) & 0xff] << 8) | (uint32_t)S[s0 & 0xff]) ^ load_be32(rk + 4));
+    store_be32(block + 8,  (((uint32_t)S[s2 >> 24] << 24) | ((uint32_t)S[(s3 >> 16) & 0xff] << 16) |
+                            ((uint32_t)S[(s0 >> 8) & 0xff] << 8) | (uint32_t)S[s1 & 0xff]) ^ load_be32(rk + 8));
+    store_be32(block + 12, (((uint32_t)S[s3 >> 24] << 24) | ((uint32_t)S[(s0 >> 16) & 0xff] << 16) |
+                            ((uint32_t)S[(s1 >> 8) & 0xff] << 8) | (uint32_t)S[s2 & 0xff]) ^ load_be32(rk + 12));
+}
@@ -1,13 +1,10 @@
 // /src/crypto/cmac.cpp
 #include "cmac.h"
+#include "crypto_utils.h"
+#include "aes_backend.h"
 #include <cstdint>
 #include <cstring>
 
-// tiny-AES-c
-extern "C" {
-#include "aes.h"
-}
-
 // Left shift a 128-bit block by 1 bit
 static inline void leftshift128(const uint8_t in[16], uint8_t out[16]) {
     uint8_t carry = 0;
@@ -19,16 +16,24 @@ static inline void leftshift128(const uint8_t in[16], uint8_t out[16]) {
 }
 
 static inline void xor128(uint8_t *a, const uint8_t *b) {
-    for (int i=0;i<16;i++) a[i]^=b[i];
+    uint64_t a0, a1, b0, b1;
+    std::memcpy(&a0, a, 8); std::memcpy(&a1, a + 8, 8);
+    std::memcpy(&b0, b, 8); std::memcpy(&b1, b + 8, 8);
+    a0 ^= b0; a1 ^= b1;
+    std::memcpy(a, &a0, 8); std::memcpy(a + 8, &a1, 8);
+}
+
+// out = a ^ b
+static inline void xor128to(uint8_t *out, const uint8_t *a, const uint8_t *b) {
+    std::memcpy(out, a, 16);
+    xor128(out, b);
 }
 
 static const uint8_t Rb = 0x87;
 
-static void generate_subkeys(const uint8_t key[16], uint8_t K1[16], uint8_t K2[16]) {
+static void generate_subkeys(const uint8_t roundKey[176], uint8_t K1[16], uint8_t K2[16]) {
     uint8_t L[16] = {0};
-    struct AES_ctx ctx;
-    AES_init_ctx(&ctx, key);
-    AES_ECB_encrypt(&ctx, L); // L = AES-128(0^128)
+    aes128_encrypt_block(roundKey, L); // L = AES-128(0^128)
 
     // K1
     uint8_t Z[16];
@@ -42,33 +47,41 @@ static void generate_subkeys(const uint8_t key[16], uint8_t K1[16], uint8_t K2[1
     std::memcpy(K2, Z, 16);
 }
 
-void aes128_cmac(const uint8_t key[16], const uint8_t* msg, size_t len, uint8_t outTag[16]) {
-    uint8_t K1[16], K2[16];
-    generate_subkeys(key, K1, K2);
+void CmacContext::init(const uint8_t key[16]) {
+    aes128_expand_key(key, roundKey_);
+    generate_subkeys(roundKey_, K1_, K2_);
+}
 
+// Padded/masked final block M_last (SP 800-38B step 4).
+void CmacContext::lastBlock(const uint8_t* msg, size_t len, uint8_t M_last[16]) const {
     // Number of 16-byte blocks
     size_t n = (len + 15) / 16;
     if (n == 0) n = 1;
 
     bool lastComplete = (len != 0) && (len % 16 == 0);
 
-    // Prepare last block
-    uint8_t M_last[16] = {0};
+    std::memset(M_last, 0, 16);
     if (lastComplete) {
         // last block is complete
         std::memcpy(M_last, msg + 16*(n-1), 16);
-        xor128(M_last, K1);
+        xor128(M_last, K1_);
     } else {
         size_t rem = (len == 0) ? 0 : (len % 16);
         if (rem > 0)
             std::memcpy(M_last, msg + 16*(n-1), rem);
         M_last[rem] = 0x80; // 10* padding
         // rest already zero
-        xor128(M_last, K2);
+        xor128(M_last, K2_);
     }
+}
 
-    struct AES_ctx ctx;
-    AES_init_ctx(&ctx, key);
+void CmacContext::tag(const uint8_t* msg, size_t len, uint8_t outTag[16]) const {
+    // Number of 16-byte blocks
+    size_t n = (len + 15) / 16;
+    if (n == 0) n = 1;
+
+    uint8_t M_last[16];
+    lastBlock(msg, len, M_last);
 
     uint8_t X[16] = {0};
     uint8_t Y[16] = {0};
@@ -77,12 +90,93 @@ void aes128_cmac(const uint8_t key[16], const uint8_t* msg, size_t len, uint8_t
     for (size_t i = 0; i < n-1; ++i) {
         std::memcpy(Y, msg + 16*i, 16);
         xor128(Y, X);
-        AES_ECB_encrypt(&ctx, Y);
+        aes128_encrypt_block(roundKey_, Y);
         std::memcpy(X, Y, 16);
     }
 
     // Final block
-    for (int i=0;i<16;i++) Y[i] = X[i] ^ M_last[i];
-    AES_ECB_encrypt(&ctx, Y);
+    xor128to(Y, X, M_last);
+    aes128_encrypt_block(roundKey_, Y);
     std::memcpy(outTag, Y, 16);
-}
\ No newline at end of file
+}
+
+bool CmacContext::verify(const uint8_t* msg, size_t len, const uint8_t* tag, size_t tagLen) const {
+    if (tagLen == 0 || tagLen > 16) return false;
+    uint8_t calc[16];
+    this->tag(msg, len, calc);
+    return ct_equal(calc, tag, tagLen);
+}
+
+void cmacIdTs(const CmacContext& ctx, int id, int64_t ts_us, uint8_t outTag[16]) {
+    uint8_t m[ID_TS_BYTES];
+    packIdTsBigEndian(id, ts_us, m);
+    ctx.tag(m, sizeof m, outTag);
+}
+
+bool cmacIdTsVerify(const CmacContext& ctx, int id, int64_t ts_us, const uint8_t* tag, size_t tagLen) {
+    uint8_t m[ID_TS_BYTES];
+    packIdTsBigEndian(id, ts_us, m);
+    return ctx.verify(m, sizeof m, tag, tagLen);
+}
+
+void cmacDeriveSensorKey(const CmacContext& master, int src, uint8_t outKey[16]) {
+    static const char label[] = "LightIoT-sensor";
+    uint8_t in[1 + sizeof(label) - 1 + 1 + 4 + 2];
+    size_t o = 0;
+    in[o++] = 0x01;                                     // counter i = 1
+    std::memcpy(in + o, label, sizeof(label) - 1); o += sizeof(label) - 1;
+    in[o++] = 0x00;                                     // separator
+    in[o++] = (uint8_t)((uint32_t)src >> 24); in[o++] = (uint8_t)((uint32_t)src >> 16);
+    in[o++] = (uint8_t)((uint32_t)src >> 8);  in[o++] = (uint8_t)src;
+    in[o++] = 0x00; in[o++] = 0x80;                     // L = 128 bits
+    master.tag(in, o, outKey);
+}
+
+void aes128_cmac(const uint8_t key[16], const uint8_t* msg, size_t len, uint8_t outTag[16]) {
+    CmacContext ctx(key);
+    ctx.tag(msg, len, outTag);
+}
+
+uint64_t aes128_cmac_verify_batch(const CmacContext& ctx, const CmacVerifyItem* items, size_t n) {
+    static const size_t kLanes = 8;
+    if (n > 64) n = 64;
+    uint64_t pass = 0;
+
+    for (size_t base = 0; base < n; base += kLanes) {
+        const size_t lanes = (n - base < kLanes) ? (n - base) : kLanes;
+        uint8_t X[kLanes][16];      // chaining value per lane
+        uint8_t last[kLanes][16];   // prepared M_last per lane
+        size_t nblk[kLanes];
+        size_t maxBlk = 0;
+        for (size_t l = 0; l < lanes; ++l) {
+            const CmacVerifyItem& it = items[base + l];
+            nblk[l] = (it.len + 15) / 16;
+            if (nblk[l] == 0) nblk[l] = 1;
+            if (nblk[l] > maxBlk) maxBlk = nblk[l];
+            ctx.lastBlock(it.msg, it.len, last[l]);
+            std::memset(X[l], 0, 16);
+        }
+
+        // Step all chains one block at a time; lanes that are done drop out.
+        uint8_t buf[kLanes * 16];
+        size_t laneOf[kLanes];
+        for (size_t j = 0; j < maxBlk; ++j) {
+            size_t cnt = 0;
+            for (size_t l = 0; l < lanes; ++l) {
+                if (j >= nblk[l]) continue;
+                const uint8_t* M = (j == nblk[l] - 1) ? last[l] : items[base + l].msg + 16*j;
+                xor128to(buf + 16*cnt, X[l], M);
+                laneOf[cnt++] = l;
+            }
+            aes128_encrypt_blocks(ctx.roundKey_, buf, cnt);
+            for (size_t c = 0; c < cnt; ++c) std::memcpy(X[laneOf[c]], buf + 16*c, 16);
+        }
+
+        for (size_t l = 0; l < lanes; ++l) {
+            const CmacVerifyItem& it = items[base + l];
+            if (it.tagLen == 0 || it.tagLen > 16) continue;
+            if (ct_equal(X[l], it.tag, it.tagLen)) pass |= (1ULL << (base + l));
+        }
+    }
+    return pass;
+}
@@ -5,4 +5,53 @@
 
 // AES-128 CMAC per NIST SP 800-38B.
 // outTag: 16-byte authentication tag.
-void aes128_cmac(const uint8_t key[16], const uint8_t* msg, size_t len, uint8_t outTag[16]);
\ No newline at end of file
+void aes128_cmac(const uint8_t key[16], const uint8_t* msg, size_t len, uint8_t outTag[16]);
+
+class CmacContext;
+
+// One (message, tag) pair for aes128_cmac_verify_batch(); tagLen <= 16.
+struct CmacVerifyItem {
+    const uint8_t* msg;
+    size_t len;
+    const uint8_t* tag;
+    size_t tagLen;
+};
+
+// Verify up to 64 pairs under one key. Bit i of the result is set when
+// items[i] verifies; items past the 64th are not checked. The independent
+// CMAC chains are advanced block by block together, so the AES backend
+// can keep several blocks in flight (aes128_encrypt_blocks).
+uint64_t aes128_cmac_verify_batch(const CmacContext& ctx, const CmacVerifyItem* items, size_t n);
+
+// Keyed CMAC state: AES-128 round keys + subkeys K1/K2, computed once in init().
+// The whole run uses one fixed key per module, so nodes keep one of these as a
+// member and call tag()/verify() per message without re-expanding the key.
+class CmacContext {
+  public:
+    CmacContext() = default;
+    explicit CmacContext(const uint8_t key[16]) { init(key); }
+
+    void init(const uint8_t key[16]);
+
+    // outTag: 16-byte authentication tag.
+    void tag(const uint8_t* msg, size_t len, uint8_t outTag[16]) const;
+    // Recompute and compare the first tagLen bytes (<=16) in constant time.
+    bool verify(const uint8_t* msg, size_t len, const uint8_t* tag, size_t tagLen = 16) const;
+
+  private:
+    friend uint64_t aes128_cmac_verify_batch(const CmacContext&, const CmacVerifyItem*, size_t);
+    void lastBlock(const uint8_t* msg, size_t len, uint8_t M_last[16]) const;
+
+    uint8_t roundKey_[176] = {0};  // 11 round keys, FIPS-197 byte order
+    uint8_t K1_[16] = {0};
+    uint8_t K2_[16] = {0};
+};
+
+// LightIoT message tag: CMAC over packIdTsBigEndian(id, ts_us).
+// Both run on stack buffers only (no heap allocation per message).
+void cmacIdTs(const CmacContext& ctx, int id, int64_t ts_us, uint8_t outTag[16]);
+bool cmacIdTsVerify(const CmacContext& ctx, int id, int64_t ts_us, const uint8_t* tag, size_t tagLen);
+
+// Per-sensor key: SP 800-108 counter-mode KDF with CMAC as PRF,
+// K_src = CMAC(master, 0x01 || "LightIoT-sensor" || 0x00 || src(BE32) || 0x0080).
+void cmacDeriveSensorKey(const CmacContext& master, int src, uint8_t outKey[16]);
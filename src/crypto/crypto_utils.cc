@@ -22,6 +22,17 @@ bool hexToBytes(const std::string& hex, std::vector<uint8_t>& out){
     return true;
 }
 
+bool hexToBytes(const std::string& hex, uint8_t* out, size_t cap, size_t& outLen){
+    outLen = 0;
+    if (hex.size()%2 || hex.size()/2 > cap) return false;
+    for (size_t i=0;i<hex.size();i+=2){
+        int hi=hexval(hex[i]); int lo=hexval(hex[i+1]);
+        if (hi<0||lo<0) { outLen = 0; return false; }
+        out[outLen++] = (uint8_t)((hi<<4)|lo);
+    }
+    return true;
+}
+
 std::string bytesToHex(const uint8_t* data, size_t len){
     std::ostringstream oss;
     for (size_t i=0;i<len;i++){
@@ -31,7 +42,11 @@ std::string bytesToHex(const uint8_t* data, size_t len){
 }
 
 void packIdTsBigEndian(int id, int64_t ts_us, std::vector<uint8_t>& out){
-    out.resize(12);
+    out.resize(ID_TS_BYTES);
+    packIdTsBigEndian(id, ts_us, out.data());
+}
+
+void packIdTsBigEndian(int id, int64_t ts_us, uint8_t out[ID_TS_BYTES]){
     // id (int32) BE
     out[0]=(uint8_t)((id>>24)&0xFF);
     out[1]=(uint8_t)((id>>16)&0xFF);
@@ -1,10 +1,27 @@
 // /src/crypto/crypto_utils.h
 #pragma once
+#include <array>
 #include <string>
 #include <vector>
+#include <cstddef>
 #include <cstdint>
 
 bool hexToBytes(const std::string& hex, std::vector<uint8_t>& out);
+// Allocation-free decode into caller storage; fails if the result exceeds cap.
+bool hexToBytes(const std::string& hex, uint8_t* out, size_t cap, size_t& outLen);
+template <size_t N>
+inline bool hexToBytes(const std::string& hex, std::array<uint8_t, N>& out, size_t& outLen) {
+    return hexToBytes(hex, out.data(), N, outLen);
+}
+
 std::string bytesToHex(const uint8_t* data, size_t len);
+
+// id (int32 BE) || ts_us (int64 BE) = 12 bytes
+static const size_t ID_TS_BYTES = 12;
 void packIdTsBigEndian(int id, int64_t ts_us, std::vector<uint8_t>& out);
+void packIdTsBigEndian(int id, int64_t ts_us, uint8_t out[ID_TS_BYTES]);
+inline void packIdTsBigEndian(int id, int64_t ts_us, std::array<uint8_t, ID_TS_BYTES>& out) {
+    packIdTsBigEndian(id, ts_us, out.data());
+}
+
 bool ct_equal(const uint8_t* a, const uint8_t* b, size_t n);
\ No newline at end of file
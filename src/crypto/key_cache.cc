@@ -0,0 +1,50 @@
+// /src/crypto/key_cache.cc
+#include "key_cache.h"
+
+void CmacKeyCache::init(const CmacContext& master, size_t capacity) {
+    master_ = master;
+    if (capacity < 1) capacity = 1;
+    slots_.assign(capacity, Slot());
+    index_.clear();
+    index_.reserve(capacity);
+    hand_ = 0;
+    hits = misses = evictions = 0;
+}
+
+const CmacContext& CmacKeyCache::get(int src) {
+    auto it = index_.find(src);
+    if (it != index_.end()) {
+        Slot& s = slots_[it->second];
+        s.ref = true;
+        hits++;
+        return s.ctx;
+    }
+    misses++;
+
+    // CLOCK: skip referenced slots once, clearing their bit
+    while (slots_[hand_].used && slots_[hand_].ref) {
+        slots_[hand_].ref = false;
+        hand_ = (hand_ + 1) % slots_.size();
+    }
+    Slot& victim = slots_[hand_];
+    if (victim.used) {
+        index_.erase(victim.src);
+        evictions++;
+    }
+
+    uint8_t key[16];
+    cmacDeriveSensorKey(master_, src, key);
+    victim.ctx.init(key);
+    victim.src = src;
+    victim.used = true;
+    victim.ref = false;
+    index_.emplace(src, (uint32_t)hand_);
+    hand_ = (hand_ + 1) % slots_.size();
+    return victim.ctx;
+}
+
+size_t CmacKeyCache::memoryBytes() const {
+    // slots + one hash node (key, value, next pointer) and bucket per entry
+    const size_t node = sizeof(void*) + sizeof(std::pair<const int, uint32_t>) + sizeof(void*);
+    return slots_.size() * sizeof(Slot) + index_.bucket_count() * sizeof(void*) + index_.size() * node;
+}
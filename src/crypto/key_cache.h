@@ -0,0 +1,39 @@
+// /src/crypto/key_cache.h
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "cmac.h"
+
+// Bounded cache of per-sensor CmacContexts keyed by src, with CLOCK
+// (second-chance) replacement. A miss derives K_src from the master key
+// (cmacDeriveSensorKey) and expands its schedule; a hit costs one lookup.
+class CmacKeyCache {
+  public:
+    void init(const CmacContext& master, size_t capacity);
+
+    // Context for src; derived and inserted on miss (may evict).
+    const CmacContext& get(int src);
+
+    size_t capacity() const { return slots_.size(); }
+    size_t size() const { return index_.size(); }
+    // approximate resident memory of the cache (slots + index)
+    size_t memoryBytes() const;
+
+    long hits = 0;
+    long misses = 0;
+    long evictions = 0;
+
+  private:
+    struct Slot {
+        int src = 0;
+        bool used = false;
+        bool ref = false;   // second-chance bit
+        CmacContext ctx;
+    };
+    CmacContext master_;
+    std::vector<Slot> slots_;
+    std::unordered_map<int, uint32_t> index_;   // src -> slot
+    size_t hand_ = 0;
+};
@@ -0,0 +1,61 @@
+// /src/dedup/aged_bloom.cc
+#include "aged_bloom.h"
+#include "hash_policy.h"
+#include <cstring>
+
+void AgedBloom::init(size_t bitsPerGen, int hashes, int generations, int64_t slice) {
+    size_t bits = 64;
+    while (bits < bitsPerGen) bits <<= 1;
+    mask_ = bits - 1;
+    words_ = bits / 64;
+    k_ = hashes < 1 ? 1 : (hashes > MAX_HASHES ? MAX_HASHES : hashes);
+    gens_ = generations < 1 ? 1 : (generations > MAX_GENERATIONS ? MAX_GENERATIONS : generations);
+    bits_.assign(words_ * (size_t)gens_, 0);
+    slice_ = slice < 1 ? 1 : slice;
+    cur_ = 0;
+    curSlice_ = 0;
+    rollovers = 0;
+}
+
+// Moves the insert generation forward to the slice containing `now`,
+// clearing every generation whose slice has ended (at most all G).
+void AgedBloom::advance(int64_t now) {
+    int64_t s = now / slice_;
+    if (s <= curSlice_) return;
+    int64_t steps = s - curSlice_;
+    if (steps > gens_) steps = gens_;
+    for (int64_t i = 0; i < steps; ++i) {
+        cur_ = (cur_ + 1) % gens_;
+        std::memset(gen(cur_), 0, words_ * sizeof(uint64_t));
+        rollovers++;
+    }
+    curSlice_ = s;
+}
+
+void AgedBloom::indices(int id, size_t* idx) const {
+    KmIndex<> km(id);
+    for (int i = 0; i < k_; ++i) idx[i] = km.masked(i, mask_);
+}
+
+bool AgedBloom::test(int id, int64_t now) {
+    if (bits_.empty()) return false;
+    advance(now);
+    size_t idx[MAX_HASHES];
+    indices(id, idx);
+    for (int g = 0; g < gens_; ++g) {
+        const uint64_t* w = gen(g);
+        int i = 0;
+        while (i < k_ && (w[idx[i] >> 6] >> (idx[i] & 63)) & 1u) ++i;
+        if (i == k_) return true;
+    }
+    return false;
+}
+
+void AgedBloom::add(int id, int64_t now) {
+    if (bits_.empty()) return;
+    advance(now);
+    size_t idx[MAX_HASHES];
+    indices(id, idx);
+    uint64_t* w = gen(cur_);
+    for (int i = 0; i < k_; ++i) w[idx[i] >> 6] |= 1ULL << (idx[i] & 63);
+}
@@ -0,0 +1,49 @@
+// /src/dedup/aged_bloom.h
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Time-sliced ("aged") Bloom filter: G generations of equal size, each
+// owning a slice of `slice` ticks of simulated time. Inserts go to the
+// generation of the current slice; when time enters a new slice the oldest
+// generation is cleared with a memset and reused. A query reports "seen" if
+// any generation holds all k bits, so an ID is remembered for between
+// (G-1)*slice and G*slice ticks. Forgetting depends only on time, never on
+// load or on a random number stream.
+// Times are in integer ticks chosen by the caller (the gateway uses µs).
+class AgedBloom {
+  public:
+    static const int MAX_HASHES = 16;
+    static const int MAX_GENERATIONS = 64;
+
+    // bitsPerGen is rounded up to a power of two (>= 64); hashes clamped
+    // to [1, MAX_HASHES], generations to [1, MAX_GENERATIONS].
+    void init(size_t bitsPerGen, int hashes, int generations, int64_t slice);
+
+    bool test(int id, int64_t now);
+    void add(int id, int64_t now);
+
+    size_t bitsPerGeneration() const { return mask_ + 1; }
+    int generations() const { return gens_; }
+    int hashes() const { return k_; }
+    int64_t slice() const { return slice_; }
+    size_t memoryBytes() const { return bits_.size() * sizeof(uint64_t); }
+
+    // stats
+    long rollovers = 0;       // generations cleared
+
+  private:
+    void advance(int64_t now);
+    void indices(int id, size_t* idx) const;
+    uint64_t* gen(int g) { return &bits_[(size_t)g * words_]; }
+
+    std::vector<uint64_t> bits_;    // generations back to back
+    size_t words_ = 0;              // uint64 words per generation
+    size_t mask_ = 0;               // bit index mask
+    int k_ = 3;
+    int gens_ = 4;
+    int cur_ = 0;                   // generation receiving inserts
+    int64_t slice_ = 1;
+    int64_t curSlice_ = 0;
+};
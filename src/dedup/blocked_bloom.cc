@@ -0,0 +1,83 @@
+// /src/dedup/blocked_bloom.cc
+#include "blocked_bloom.h"
+#include "hash_policy.h"
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+void BlockedBloom::init(size_t bits, int hashes) {
+    size_t n = 1;
+    while (n * BLOCK_BITS < bits) n <<= 1;
+    blocks_.assign(n, Block{});
+    mask_ = n - 1;
+    k_ = hashes < 1 ? 1 : (hashes > MAX_HASHES ? MAX_HASHES : hashes);
+}
+
+size_t BlockedBloom::pattern(int id, Block& p) const {
+    // one hash: high bits pick the block, double hashing on bits 0..8 and
+    // 23..31 (disjoint from the block bits) places the k bits inside it
+    uint64_t h = DedupHash::hash((uint64_t)(uint32_t)id);
+    size_t block = (size_t)(h >> 32) & mask_;
+    uint32_t a = (uint32_t)h;
+    uint32_t b = (uint32_t)(h >> 23) | 1u;
+    std::memset(p.w, 0, sizeof(p.w));
+    for (int i = 0; i < k_; ++i) {
+        unsigned pos = (a + (uint32_t)i * b) & 511u;
+        p.w[pos >> 6] |= 1ULL << (pos & 63);
+    }
+    return block;
+}
+
+bool BlockedBloom::test(int id) const {
+    if (blocks_.empty()) return false;
+    Block p;
+    const Block& b = blocks_[pattern(id, p)];
+    // all pattern bits set  <=>  (b & p) == p  over the whole 512-bit block
+#if defined(__AVX2__)
+    __m256i p0 = _mm256_load_si256((const __m256i*)&p.w[0]);
+    __m256i p1 = _mm256_load_si256((const __m256i*)&p.w[4]);
+    __m256i m0 = _mm256_andnot_si256(_mm256_load_si256((const __m256i*)&b.w[0]), p0);
+    __m256i m1 = _mm256_andnot_si256(_mm256_load_si256((const __m256i*)&b.w[4]), p1);
+    return _mm256_testz_si256(_mm256_or_si256(m0, m1), _mm256_or_si256(m0, m1)) != 0;
+#elif defined(__SSE2__)
+    __m128i miss = _mm_setzero_si128();
+    for (int i = 0; i < 8; i += 2) {
+        __m128i pv = _mm_load_si128((const __m128i*)&p.w[i]);
+        __m128i bv = _mm_load_si128((const __m128i*)&b.w[i]);
+        miss = _mm_or_si128(miss, _mm_andnot_si128(bv, pv));
+    }
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(miss, _mm_setzero_si128())) == 0xFFFF;
+#else
+    uint64_t miss = 0;
+    for (int i = 0; i < 8; ++i) miss |= p.w[i] & ~b.w[i];
+    return miss == 0;
+#endif
+}
+
+void BlockedBloom::add(int id) {
+    if (blocks_.empty()) return;
+    Block p;
+    Block& b = blocks_[pattern(id, p)];
+    for (int i = 0; i < 8; ++i) b.w[i] |= p.w[i];
+}
+
+double BlockedBloom::expectedFp(long n) const {
+    if (blocks_.empty() || n <= 0) return 0.0;
+    // block load ~ Poisson(n / blocks); FP of a block with load i is
+    // (1 - (1 - 1/512)^(k*i))^k
+    const double lambda = (double)n / (double)blocks_.size();
+    const double q = std::log1p(-1.0 / (double)BLOCK_BITS);
+    const long hi = (long)(lambda + 10.0 * std::sqrt(lambda) + 20.0);
+    double fp = 0.0;
+    for (long i = 0; i <= hi; ++i) {
+        double logP = -lambda + (double)i * std::log(lambda) - std::lgamma((double)i + 1.0);
+        double fill = 1.0 - std::exp(q * (double)k_ * (double)i);
+        fp += std::exp(logP) * std::pow(fill, (double)k_);
+    }
+    return fp;
+}
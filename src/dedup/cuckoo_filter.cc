@@ -0,0 +1,157 @@
+// /src/dedup/cuckoo_filter.cc
+#include "cuckoo_filter.h"
+#include <utility>
+
+// buckets examined by the retention sweep per insert
+static const size_t SWEEP_STEP = 2;
+// epochs per retention period (insert time resolution = retention / 16)
+static const int64_t EPOCHS_PER_RETENTION = 16;
+
+static inline uint64_t mix64(uint64_t x) {
+    // splitmix64 finalizer
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+void CuckooFilter::init(size_t capacity, int fpBits, int bucketSize, int maxKicksPar, int64_t retention) {
+    fpBits_ = fpBits < MIN_FP_BITS ? MIN_FP_BITS : (fpBits > MAX_FP_BITS ? MAX_FP_BITS : fpBits);
+    bucket_ = bucketSize < 1 ? 1 : (bucketSize > 8 ? 8 : bucketSize);
+    kickLimit_ = maxKicksPar < 0 ? 0 : maxKicksPar;
+    size_t buckets = 2;
+    while (buckets * (size_t)bucket_ < capacity) buckets <<= 1;
+    fp_.assign(buckets * (size_t)bucket_, 0);
+    epoch_.assign(buckets * (size_t)bucket_, 0);
+    mask_ = buckets - 1;
+    size_ = 0;
+    cursor_ = 0;
+    if (retention < 1) retention = 1;
+    epochLen_ = retention / EPOCHS_PER_RETENTION;
+    if (epochLen_ < 1) epochLen_ = 1;
+    retentionEpochs_ = (uint32_t)((retention + epochLen_ - 1) / epochLen_);
+    victim_ = Victim();
+    lookups = inserts = kicksTotal = maxKicks = expired = insertFail = 0;
+    maxLoadFactor = 0;
+}
+
+uint16_t CuckooFilter::fingerprint(uint64_t h) const {
+    uint16_t f = (uint16_t)(h & ((1u << fpBits_) - 1u));
+    return f == 0 ? 1 : f;    // 0 marks an empty slot
+}
+
+size_t CuckooFilter::altBucket(size_t b, uint16_t fp) const {
+    // involution: altBucket(altBucket(b, fp), fp) == b
+    return (b ^ (size_t)(mix64(fp) >> 32)) & mask_;
+}
+
+uint32_t CuckooFilter::nextRand() {
+    // xorshift32
+    rng_ ^= rng_ << 13; rng_ ^= rng_ >> 17; rng_ ^= rng_ << 5;
+    return rng_;
+}
+
+bool CuckooFilter::findIn(size_t b, uint16_t fp, uint32_t cur) {
+    size_t base = b * (size_t)bucket_;
+    for (int j = 0; j < bucket_; ++j) {
+        size_t i = base + (size_t)j;
+        if (fp_[i] != fp) continue;
+        if (!isExpired(epoch_[i], cur)) return true;
+        fp_[i] = 0; size_--; expired++;
+    }
+    return false;
+}
+
+bool CuckooFilter::placeIn(size_t b, uint16_t fp, uint32_t e, uint32_t cur) {
+    size_t base = b * (size_t)bucket_;
+    for (int j = 0; j < bucket_; ++j) {
+        size_t i = base + (size_t)j;
+        if (fp_[i] != 0 && isExpired(epoch_[i], cur)) { fp_[i] = 0; size_--; expired++; }
+        if (fp_[i] == 0) {
+            fp_[i] = fp; epoch_[i] = e; size_++;
+            return true;
+        }
+    }
+    return false;
+}
+
+void CuckooFilter::expireBucket(size_t b, uint32_t cur) {
+    size_t base = b * (size_t)bucket_;
+    for (int j = 0; j < bucket_; ++j) {
+        size_t i = base + (size_t)j;
+        if (fp_[i] != 0 && isExpired(epoch_[i], cur)) { fp_[i] = 0; size_--; expired++; }
+    }
+}
+
+void CuckooFilter::noteLoad() {
+    double lf = loadFactor();
+    if (lf > maxLoadFactor) maxLoadFactor = lf;
+}
+
+bool CuckooFilter::contains(int id, int64_t now) {
+    if (fp_.empty()) return false;
+    lookups++;
+    const uint32_t cur = epochOf(now);
+    const uint64_t h = mix64((uint64_t)(uint32_t)id);
+    const uint16_t f = fingerprint(h);
+    const size_t b1 = (size_t)(h >> 32) & mask_;
+    const size_t b2 = altBucket(b1, f);
+    if (victim_.used && victim_.fp == f && (victim_.bucket == b1 || victim_.bucket == b2)) {
+        if (!isExpired(victim_.epoch, cur)) return true;
+        victim_.used = false; expired++;
+    }
+    return findIn(b1, f, cur) || findIn(b2, f, cur);
+}
+
+bool CuckooFilter::insert(int id, int64_t now) {
+    if (fp_.empty()) return false;
+    inserts++;
+    const uint32_t cur = epochOf(now);
+    for (size_t n = 0; n < SWEEP_STEP; ++n) {
+        expireBucket(cursor_, cur);
+        cursor_ = (cursor_ + 1) & mask_;
+    }
+
+    // re-home the stashed victim once expiry has freed room for it
+    if (victim_.used) {
+        if (isExpired(victim_.epoch, cur)) { victim_.used = false; expired++; }
+        else if (placeIn(victim_.bucket, victim_.fp, victim_.epoch, cur) ||
+                 placeIn(altBucket(victim_.bucket, victim_.fp), victim_.fp, victim_.epoch, cur))
+            victim_.used = false;
+    }
+
+    const uint64_t h = mix64((uint64_t)(uint32_t)id);
+    uint16_t f = fingerprint(h);
+    uint32_t e = cur;
+    const size_t b1 = (size_t)(h >> 32) & mask_;
+    const size_t b2 = altBucket(b1, f);
+    if (placeIn(b1, f, e, cur) || placeIn(b2, f, e, cur)) { noteLoad(); return true; }
+    if (victim_.used) { insertFail++; return false; }
+
+    // kick: evict a random resident and move it to its alternate bucket
+    size_t b = (nextRand() & 1u) ? b1 : b2;
+    long kicks = 0;
+    bool placed = false;
+    while (!placed && kicks < kickLimit_) {
+        size_t i = b * (size_t)bucket_ + (size_t)(nextRand() % (uint32_t)bucket_);
+        std::swap(f, fp_[i]);
+        std::swap(e, epoch_[i]);
+        b = altBucket(b, f);
+        ++kicks;
+        placed = placeIn(b, f, e, cur);
+    }
+    kicksTotal += kicks;
+    if (kicks > maxKicks) maxKicks = kicks;
+    if (!placed) {
+        // chain exhausted: park the last homeless entry in the stash
+        victim_.used = true; victim_.fp = f; victim_.epoch = e; victim_.bucket = b;
+    }
+    noteLoad();
+    return true;
+}
+
+void CuckooFilter::purge(int64_t now) {
+    const uint32_t cur = epochOf(now);
+    for (size_t b = 0; b <= mask_ && !fp_.empty(); ++b) expireBucket(b, cur);
+    if (victim_.used && isExpired(victim_.epoch, cur)) { victim_.used = false; expired++; }
+}
@@ -0,0 +1,79 @@
+// /src/dedup/cuckoo_filter.h
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Cuckoo filter (Fan et al., CoNEXT'14) over message IDs with explicit
+// time-based expiry. Each ID is stored as an f-bit fingerprint in one of two
+// buckets (partial-key cuckoo hashing, power-of-two bucket count), together
+// with a coarse insert epoch. Entries older than `retention` are treated as
+// absent and removed by lookups, inserts and an incremental sweep, so the
+// table holds only IDs inside the freshness window and neither memory nor
+// FP rate drifts over long runs.
+// Times are in integer ticks chosen by the caller (the gateway uses µs).
+class CuckooFilter {
+  public:
+    static const int MIN_FP_BITS = 4;
+    static const int MAX_FP_BITS = 16;
+
+    // capacity (slots) is rounded up to a power-of-two number of buckets;
+    // fpBits is clamped to [4,16]; bucketSize to [1,8].
+    void init(size_t capacity, int fpBits, int bucketSize, int maxKicks, int64_t retention);
+
+    bool contains(int id, int64_t now);
+    // Returns false (insertFail) if both buckets are full while the stash
+    // already holds a homeless entry from an earlier kick chain.
+    bool insert(int id, int64_t now);
+    // Removes every expired entry (e.g. before reporting the load factor).
+    void purge(int64_t now);
+
+    size_t capacity() const { return fp_.size(); }
+    size_t size() const { return size_; }
+    double loadFactor() const { return fp_.empty() ? 0.0 : (double)size_ / (double)fp_.size(); }
+    int fpBits() const { return fpBits_; }
+    int bucketSize() const { return bucket_; }
+    size_t memoryBytes() const { return fp_.size() * (sizeof(uint16_t) + sizeof(uint32_t)); }
+
+    // stats
+    long lookups = 0;
+    long inserts = 0;
+    long kicksTotal = 0;      // relocations over all inserts
+    long maxKicks = 0;        // longest relocation chain of one insert
+    long expired = 0;         // entries removed by retention
+    long insertFail = 0;
+    double maxLoadFactor = 0;
+
+  private:
+    // Victim stash: the entry left homeless by a kick chain that hit
+    // maxKicks. While it is occupied, inserts that need kicking fail.
+    struct Victim {
+        bool used = false;
+        uint16_t fp = 0;
+        uint32_t epoch = 0;
+        size_t bucket = 0;
+    };
+
+    uint32_t epochOf(int64_t now) const { return (uint32_t)(now / epochLen_); }
+    bool isExpired(uint32_t e, uint32_t cur) const { return cur - e > retentionEpochs_; }
+    uint16_t fingerprint(uint64_t h) const;
+    size_t altBucket(size_t b, uint16_t fp) const;
+    bool findIn(size_t b, uint16_t fp, uint32_t cur);
+    bool placeIn(size_t b, uint16_t fp, uint32_t e, uint32_t cur);
+    void expireBucket(size_t b, uint32_t cur);
+    void noteLoad();
+    uint32_t nextRand();
+
+    std::vector<uint16_t> fp_;      // 0 = empty slot
+    std::vector<uint32_t> epoch_;
+    size_t mask_ = 0;               // bucket index mask
+    size_t size_ = 0;
+    size_t cursor_ = 0;
+    int fpBits_ = 12;
+    int bucket_ = 4;
+    int kickLimit_ = 500;
+    int64_t epochLen_ = 1;
+    uint32_t retentionEpochs_ = 0;
+    uint32_t rng_ = 0x9e3779b9u;    // private xorshift, simulation RNG untouched
+    Victim victim_;
+};
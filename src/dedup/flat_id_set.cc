@@ -0,0 +1,111 @@
+// /src/dedup/flat_id_set.cc
+#include "flat_id_set.h"
+
+// slots examined by the retention sweep per insert
+static const size_t SWEEP_STEP = 2;
+
+void FlatIdSet::init(size_t capacity, int64_t retention, double maxLoad) {
+    size_t cap = 8;
+    while (cap < capacity) cap <<= 1;
+    slots_.assign(cap, Slot{0, EMPTY});
+    mask_ = cap - 1;
+    size_ = 0;
+    if (maxLoad <= 0 || maxLoad >= 1) maxLoad = 0.75;
+    maxSize_ = (size_t)((double)cap * maxLoad);
+    if (maxSize_ < 1) maxSize_ = 1;
+    cursor_ = 0;
+    retention_ = retention;
+    lookups = probesTotal = maxProbe = expired = insertFail = 0;
+    maxOccupancy = 0;
+}
+
+size_t FlatIdSet::home(int id) const {
+    // murmur3 fmix32: consecutive IDs spread over the table
+    uint32_t h = (uint32_t)id;
+    h ^= h >> 16; h *= 0x85ebca6bu;
+    h ^= h >> 13; h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return (size_t)h & mask_;
+}
+
+void FlatIdSet::noteProbe(long n) {
+    lookups++;
+    probesTotal += n;
+    if (n > maxProbe) maxProbe = n;
+}
+
+bool FlatIdSet::contains(int id, int64_t now) {
+    if (slots_.empty()) return false;
+    long n = 0;
+    for (size_t i = home(id); ; i = (i + 1) & mask_) {
+        ++n;
+        const Slot& s = slots_[i];
+        if (s.t == EMPTY) { noteProbe(n); return false; }
+        if (s.id == id) { noteProbe(n); return !isExpired(s, now); }
+    }
+}
+
+bool FlatIdSet::insert(int id, int64_t now) {
+    if (slots_.empty()) return false;
+    sweep(now, SWEEP_STEP);
+
+    long n = 0;
+    size_t i = home(id);
+    for (; ; i = (i + 1) & mask_) {
+        ++n;
+        Slot& s = slots_[i];
+        if (s.t == EMPTY) break;
+        if (s.id == id) { s.t = now; noteProbe(n); return true; }  // refresh
+    }
+    noteProbe(n);
+
+    if (size_ >= maxSize_) {
+        purge(now);
+        if (size_ >= maxSize_) { insertFail++; return false; }
+        // purge may have moved entries; find the free slot again
+        for (i = home(id); slots_[i].t != EMPTY; i = (i + 1) & mask_) {}
+    }
+    slots_[i] = Slot{(int32_t)id, now};
+    size_++;
+    double occ = occupancy();
+    if (occ > maxOccupancy) maxOccupancy = occ;
+    return true;
+}
+
+// Backward-shift deletion: pull later members of the probe run into the
+// hole so lookups never need tombstones.
+void FlatIdSet::erase(size_t i) {
+    size_t j = i;
+    for (;;) {
+        j = (j + 1) & mask_;
+        if (slots_[j].t == EMPTY) break;
+        size_t k = home(slots_[j].id);
+        // move slot j back to i unless its home lies cyclically in (i, j]
+        bool inRange = (i <= j) ? (i < k && k <= j) : (i < k || k <= j);
+        if (!inRange) {
+            slots_[i] = slots_[j];
+            i = j;
+        }
+    }
+    slots_[i].t = EMPTY;
+    size_--;
+}
+
+void FlatIdSet::sweep(int64_t now, size_t steps) {
+    for (size_t n = 0; n < steps && size_ > 0; ++n) {
+        Slot& s = slots_[cursor_];
+        if (s.t != EMPTY && isExpired(s, now)) {
+            erase(cursor_);      // re-check cursor_: a later entry may have moved in
+            expired++;
+            continue;
+        }
+        cursor_ = (cursor_ + 1) & mask_;
+    }
+}
+
+void FlatIdSet::purge(int64_t now) {
+    for (size_t i = 0; i < slots_.size(); ) {
+        if (slots_[i].t != EMPTY && isExpired(slots_[i], now)) { erase(i); expired++; }
+        else ++i;
+    }
+}
@@ -0,0 +1,54 @@
+// /src/dedup/flat_id_set.h
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Fixed-capacity open-addressing set of message IDs with insert times.
+// Linear probing over a power-of-two table; entries older than `retention`
+// count as absent and are removed by an incremental sweep (backward-shift
+// deletion, no tombstones), so memory never grows past the initial table.
+// Times are in integer ticks chosen by the caller (the gateway uses µs).
+class FlatIdSet {
+  public:
+    // capacity is rounded up to a power of two; maxLoad caps occupancy.
+    void init(size_t capacity, int64_t retention, double maxLoad = 0.75);
+
+    bool contains(int id, int64_t now);
+    // Returns false if the table is full even after purging expired entries.
+    bool insert(int id, int64_t now);
+
+    size_t capacity() const { return slots_.size(); }
+    size_t size() const { return size_; }
+    double occupancy() const { return slots_.empty() ? 0.0 : (double)size_ / (double)slots_.size(); }
+    size_t memoryBytes() const { return slots_.size() * sizeof(Slot); }
+
+    // stats
+    long lookups = 0;
+    long probesTotal = 0;     // slots touched by contains()/insert()
+    long maxProbe = 0;
+    long expired = 0;         // entries removed by retention
+    long insertFail = 0;
+    double maxOccupancy = 0;
+
+  private:
+    struct Slot {
+        int32_t id;
+        int64_t t;            // insert time; EMPTY when unused
+    };
+    static constexpr int64_t EMPTY = INT64_MIN;
+
+    size_t home(int id) const;
+    bool isExpired(const Slot& s, int64_t now) const { return now - s.t > retention_; }
+    void erase(size_t i);
+    void sweep(int64_t now, size_t steps);
+    void purge(int64_t now);
+    void noteProbe(long n);
+
+    std::vector<Slot> slots_;
+    size_t mask_ = 0;
+    size_t size_ = 0;
+    size_t maxSize_ = 0;
+    size_t cursor_ = 0;
+    int64_t retention_ = 0;
+};
@@ -0,0 +1,92 @@
+// /src/dedup/fp_oracle.cc
+#include "fp_oracle.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+static inline uint64_t mix64(uint64_t x) {
+    // splitmix64 finalizer
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+bool FpOracle::configure(const std::string& spec) {
+    queries_ = falsePos_ = 0;
+    slots_.clear(); size_ = 0; hasEmptyKey_ = false;
+    if (spec == "off") { mode_ = OFF; return true; }
+    if (spec == "full" || spec.empty()) { mode_ = FULL; rate_ = 1.0; threshold_ = UINT64_MAX; return true; }
+    if (spec.compare(0, 8, "sampled:") == 0) {
+        char* end = nullptr;
+        double p = std::strtod(spec.c_str() + 8, &end);
+        if (end && *end == '\0' && p > 0.0 && p <= 1.0) {
+            if (p >= 1.0) { mode_ = FULL; rate_ = 1.0; threshold_ = UINT64_MAX; return true; }
+            mode_ = SAMPLED;
+            rate_ = p;
+            // p * 2^64 may round up to 2^64, which does not fit (the cast would be UB)
+            double t = std::ldexp(p, 64);
+            threshold_ = (t >= 18446744073709551616.0) ? UINT64_MAX : (uint64_t)t;
+            return true;
+        }
+    }
+    mode_ = FULL; rate_ = 1.0; threshold_ = UINT64_MAX;
+    return false;
+}
+
+bool FpOracle::sampled(int id) const {
+    if (mode_ == FULL) return true;
+    return mix64((uint64_t)(uint32_t)id) <= threshold_;
+}
+
+bool FpOracle::contains(int id) const {
+    if (id == EMPTY) return hasEmptyKey_;
+    if (slots_.empty()) return false;
+    const size_t mask = slots_.size() - 1;
+    for (size_t i = (size_t)mix64((uint64_t)(uint32_t)id) & mask; ; i = (i + 1) & mask) {
+        if (slots_[i] == EMPTY) return false;
+        if (slots_[i] == id) return true;
+    }
+}
+
+void FpOracle::grow() {
+    std::vector<int32_t> old;
+    old.swap(slots_);
+    slots_.assign(old.empty() ? 1024 : old.size() * 2, EMPTY);
+    size_ = 0;
+    for (int32_t v : old) if (v != EMPTY) insert(v);
+}
+
+void FpOracle::insert(int id) {
+    if (id == EMPTY) { hasEmptyKey_ = true; return; }
+    if ((size_ + 1) * 2 > slots_.size()) grow();
+    const size_t mask = slots_.size() - 1;
+    for (size_t i = (size_t)mix64((uint64_t)(uint32_t)id) & mask; ; i = (i + 1) & mask) {
+        if (slots_[i] == id) return;
+        if (slots_[i] == EMPTY) { slots_[i] = id; size_++; return; }
+    }
+}
+
+void FpOracle::recordAccepted(int id) {
+    if (mode_ == OFF || !sampled(id)) return;
+    insert(id);
+}
+
+void FpOracle::recordQuery(int id, bool maybe) {
+    if (mode_ == OFF || !sampled(id)) return;
+    queries_++;
+    if (maybe && !contains(id)) falsePos_++;
+}
+
+void FpOracle::confidence95(double& lo, double& hi) const {
+    lo = hi = 0.0;
+    if (queries_ <= 0) return;
+    const double z = 1.96;
+    const double n = (double)queries_;
+    const double p = estimate();
+    const double den = 1.0 + z*z/n;
+    const double center = (p + z*z/(2*n)) / den;
+    const double half = z * std::sqrt(p*(1-p)/n + z*z/(4*n*n)) / den;
+    lo = std::max(0.0, center - half);
+    hi = std::min(1.0, center + half);
+}
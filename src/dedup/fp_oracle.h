@@ -0,0 +1,57 @@
+// /src/dedup/fp_oracle.h
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Ground-truth oracle for the false-positive rate of approximate duplicate
+// filters (bloom/sbf/...). Modes:
+//   "off"        no state, no per-message work; FP is not estimated
+//   "full"       every accepted ID is remembered exactly
+//   "sampled:p"  only IDs whose hash falls in a fraction p are remembered
+//                and checked; FP is estimated from that subset
+// Sampling is by ID hash, so all copies of an ID are in or out together.
+class FpOracle {
+  public:
+    enum Mode { OFF, FULL, SAMPLED };
+
+    // Parses the spec above; returns false (and selects FULL) if invalid.
+    bool configure(const std::string& spec);
+    void disable() { mode_ = OFF; }
+
+    bool enabled() const { return mode_ != OFF; }
+    Mode mode() const { return mode_; }
+    double rate() const { return mode_ == OFF ? 0.0 : rate_; }
+
+    // accepted (passed all stages) → remembered if sampled
+    void recordAccepted(int id);
+    // one filter query: maybe=true means the filter reported "seen"
+    void recordQuery(int id, bool maybe);
+
+    long queries() const { return queries_; }
+    long falsePositives() const { return falsePos_; }
+    double estimate() const { return queries_ > 0 ? (double)falsePos_ / (double)queries_ : 0.0; }
+    // 95% Wilson score interval for estimate()
+    void confidence95(double& lo, double& hi) const;
+    size_t memoryBytes() const { return slots_.size() * sizeof(int32_t); }
+
+  private:
+    bool sampled(int id) const;
+    bool contains(int id) const;
+    void insert(int id);
+    void grow();
+
+    Mode mode_ = FULL;
+    double rate_ = 1.0;
+    uint64_t threshold_ = UINT64_MAX;  // sampled iff hash(id) <= threshold_
+
+    // compact exact set: open addressing over int32, grows at 50% load
+    static constexpr int32_t EMPTY = INT32_MIN;
+    std::vector<int32_t> slots_;
+    size_t size_ = 0;
+    bool hasEmptyKey_ = false;         // INT32_MIN itself is stored out of band
+
+    long queries_ = 0;
+    long falsePos_ = 0;
+};
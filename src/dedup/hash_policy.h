@@ -0,0 +1,95 @@
+// /src/dedup/hash_policy.h
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// Compile-time hash policies for the Bloom-family duplicate filters
+// (bloom, blocked_bloom, aged_bloom, sbf). Each policy maps a 64-bit key to
+// a well-mixed 64-bit hash; KmIndex then derives all k probe indices from
+// that single hash by Kirsch–Mitzenmacher double hashing,
+//   g_i = h1 + i * h2   (h1 = low 32 bits, h2 = high 32 bits | 1),
+// which keeps the asymptotic FP rate of k independent hashes.
+//
+// Select the policy at build time (default wyhash):
+//   -DLIGHTIOT_HASH_WYHASH | -DLIGHTIOT_HASH_XXH3 | -DLIGHTIOT_HASH_SPLITMIX
+//   -DLIGHTIOT_HASH_STD    (legacy std::hash, identity on libstdc++)
+
+// wyhash-style: 64x64->128 multiply, fold high and low halves
+struct WyHashPolicy {
+    static const char* name() { return "wyhash"; }
+    static inline uint64_t mum(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+        unsigned __int128 r = (unsigned __int128)a * b;
+        return (uint64_t)r ^ (uint64_t)(r >> 64);
+#else
+        uint64_t ha = a >> 32, la = (uint32_t)a, hb = b >> 32, lb = (uint32_t)b;
+        uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+        uint64_t t = rl + (rm0 << 32), c = t < rl;
+        uint64_t lo = t + (rm1 << 32);
+        c += lo < t;
+        uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+        return lo ^ hi;
+#endif
+    }
+    static inline uint64_t hash(uint64_t x) {
+        return mum(mum(x ^ 0xa0761d6478bd642fULL, x ^ 0xe7037ed1a0b428dbULL) ^ 0x8ebc6af09c88c6e3ULL,
+                   0x589965cc75374cc3ULL ^ 8);
+    }
+};
+
+// XXH3 8-byte path: rrmxmx avalanche over key ^ secret
+struct Xxh3HashPolicy {
+    static const char* name() { return "xxh3"; }
+    static inline uint64_t rotl(uint64_t v, int r) { return (v << r) | (v >> (64 - r)); }
+    static inline uint64_t hash(uint64_t x) {
+        uint64_t h = x ^ 0x1cad21f72c81017cULL;
+        h ^= rotl(h, 49) ^ rotl(h, 24);
+        h *= 0x9fb21c651e98df25ULL;
+        h ^= (h >> 35) + 8;
+        h *= 0x9fb21c651e98df25ULL;
+        return h ^ (h >> 28);
+    }
+};
+
+// splitmix64 finalizer
+struct SplitMixHashPolicy {
+    static const char* name() { return "splitmix"; }
+    static inline uint64_t hash(uint64_t x) {
+        x += 0x9e3779b97f4a7c15ULL;
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+};
+
+// legacy GatewayNode::hashMix (seed 0): kept for comparison runs only
+struct StdHashPolicy {
+    static const char* name() { return "std"; }
+    static inline uint64_t hash(uint64_t x) { return (uint64_t)std::hash<uint64_t>{}(x); }
+};
+
+#if defined(LIGHTIOT_HASH_STD)
+typedef StdHashPolicy DedupHash;
+#elif defined(LIGHTIOT_HASH_SPLITMIX)
+typedef SplitMixHashPolicy DedupHash;
+#elif defined(LIGHTIOT_HASH_XXH3)
+typedef Xxh3HashPolicy DedupHash;
+#else
+typedef WyHashPolicy DedupHash;
+#endif
+
+// k indices from one hash (Kirsch–Mitzenmacher).
+template <class H = DedupHash>
+struct KmIndex {
+    uint64_t h1, h2;
+    explicit KmIndex(int id) {
+        uint64_t h = H::hash((uint64_t)(uint32_t)id);
+        h1 = (uint32_t)h;
+        h2 = (h >> 32) | 1u;      // odd: never degenerates to one probe
+    }
+    // power-of-two table: index i under `mask`
+    size_t masked(int i, size_t mask) const { return (size_t)(h1 + (uint64_t)i * h2) & mask; }
+    // arbitrary table size m
+    size_t mod(int i, size_t m) const { return (size_t)((h1 + (uint64_t)i * h2) % m); }
+};
@@ -0,0 +1,95 @@
+// /src/dedup/packed_sbf.cc
+#include "packed_sbf.h"
+#include "hash_policy.h"
+#include <algorithm>
+
+static const uint64_t LOW_NIBBLE_BITS = 0x1111111111111111ULL;
+
+// bit 4j set iff counter j of w is non-zero
+static inline uint64_t nonZeroLanes(uint64_t w) {
+    return (w | (w >> 1) | (w >> 2) | (w >> 3)) & LOW_NIBBLE_BITS;
+}
+
+void PackedSbf::init(size_t bits, int hashes, int64_t period) {
+    size_t n = COUNTERS_PER_WORD;
+    while (n * 4 < bits) n <<= 1;
+    words_.assign(n / COUNTERS_PER_WORD, 0);
+    mask_ = n - 1;
+    cursor_ = 0;
+    k_ = hashes < 1 ? 1 : (hashes > MAX_HASHES ? MAX_HASHES : hashes);
+    period_ = period;
+    done_ = 0;
+    decayedCells = saturated = 0;
+}
+
+void PackedSbf::indices(int id, size_t* idx) const {
+    KmIndex<> km(id);
+    for (int i = 0; i < k_; ++i) idx[i] = km.masked(i, mask_);
+}
+
+bool PackedSbf::test(int id) const {
+    if (words_.empty()) return false;
+    size_t idx[MAX_HASHES];
+    indices(id, idx);
+    for (int i = 0; i < k_; ++i)
+        if (((words_[idx[i] >> 4] >> ((idx[i] & 15) * 4)) & 15u) == 0) return false;
+    return true;
+}
+
+void PackedSbf::add(int id) {
+    if (words_.empty()) return;
+    size_t idx[MAX_HASHES];
+    indices(id, idx);
+    for (int i = 0; i < k_; ++i) {
+        uint64_t& w = words_[idx[i] >> 4];
+        unsigned sh = (unsigned)(idx[i] & 15) * 4;
+        // saturating +1: the lane cannot carry because 15 is skipped
+        if (((w >> sh) & 15u) != 15u) w += 1ULL << sh;
+        else saturated++;
+    }
+}
+
+// SWAR decrement-if-non-zero of words [from, to); the first/last word are
+// restricted to the lanes in firstMask/lastMask (LOW_NIBBLE_BITS = all).
+void PackedSbf::decayWords(size_t from, size_t to, uint64_t firstMask, uint64_t lastMask) {
+    for (size_t i = from; i < to; ++i) {
+        uint64_t lanes = LOW_NIBBLE_BITS;
+        if (i == from) lanes &= firstMask;
+        if (i + 1 == to) lanes &= lastMask;
+        words_[i] -= nonZeroLanes(words_[i]) & lanes;
+    }
+}
+
+void PackedSbf::decay(size_t n) {
+    if (words_.empty() || n == 0) return;
+    const size_t total = counters();
+    if (n > total) n = total;
+    decayedCells += (long)n;
+    while (n > 0) {
+        size_t run = std::min(n, total - cursor_);        // up to the array end
+        size_t a = cursor_, b = cursor_ + run;             // counters [a, b)
+        uint64_t firstMask = LOW_NIBBLE_BITS << ((a & 15) * 4);
+        uint64_t lastMask = (b & 15) ? (LOW_NIBBLE_BITS >> ((16 - (b & 15)) * 4)) : LOW_NIBBLE_BITS;
+        decayWords(a >> 4, (b + 15) >> 4, firstMask, lastMask);
+        cursor_ = b & mask_;
+        n -= run;
+    }
+}
+
+void PackedSbf::tick(int64_t now) {
+    if (period_ <= 0 || words_.empty() || now <= 0) return;
+    const int64_t total = (int64_t)counters();
+    // counters that should have been decayed by `now`, without overflow
+    int64_t target = (now / period_) * total + (now % period_) * total / period_;
+    int64_t d = target - done_;
+    if (d <= 0) return;
+    done_ = target;
+    int64_t passes = d / total;
+    if (passes >= 15) {                     // every counter reaches zero
+        std::fill(words_.begin(), words_.end(), 0);
+        decayedCells += (long)d;
+        return;
+    }
+    for (int64_t p = 0; p < passes; ++p) decay((size_t)total);
+    decay((size_t)(d % total));
+}
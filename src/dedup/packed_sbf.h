@@ -0,0 +1,51 @@
+// /src/dedup/packed_sbf.h
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Stable Bloom filter with 4-bit counters packed 16 per uint64 word.
+// Insert is a saturating increment (max 15) of k counters; a query reports
+// "seen" when all k are non-zero. Forgetting decrements a contiguous range
+// of counters at a rotating cursor with a SWAR kernel (one subtract per 16
+// counters), so decay is deterministic and never touches an RNG:
+//   - period > 0: the cursor sweeps the whole array once per `period` ticks
+//     of time, advanced lazily by tick(now);
+//   - otherwise the caller decays a fixed count per insert via decay(n).
+class PackedSbf {
+  public:
+    static const int MAX_HASHES = 16;
+    static const size_t COUNTERS_PER_WORD = 16;
+
+    // bits is the memory footprint; the counter count (bits/4) is rounded
+    // up to a power of two >= 16. hashes is clamped to [1, MAX_HASHES].
+    void init(size_t bits, int hashes, int64_t period);
+
+    bool test(int id) const;
+    void add(int id);
+    // time-driven decay up to `now` (no-op when period <= 0)
+    void tick(int64_t now);
+    // decrement the next n counters at the cursor (wraps around)
+    void decay(size_t n);
+
+    size_t counters() const { return mask_ + 1; }
+    size_t bits() const { return counters() * 4; }
+    int hashes() const { return k_; }
+    size_t memoryBytes() const { return words_.size() * sizeof(uint64_t); }
+    uint8_t counter(size_t i) const { return (uint8_t)((words_[i >> 4] >> ((i & 15) * 4)) & 15u); }
+
+    // stats
+    long decayedCells = 0;    // counters visited by decay
+    long saturated = 0;       // increments dropped at 15
+
+  private:
+    void indices(int id, size_t* idx) const;
+    void decayWords(size_t from, size_t to, uint64_t firstMask, uint64_t lastMask);
+
+    std::vector<uint64_t> words_;
+    size_t mask_ = 0;               // counter index mask
+    size_t cursor_ = 0;             // next counter to decay
+    int k_ = 3;
+    int64_t period_ = 0;
+    int64_t done_ = 0;              // counters decayed so far by tick()
+};
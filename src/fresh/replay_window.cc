@@ -0,0 +1,28 @@
+// /src/fresh/replay_window.cc
+#include "replay_window.h"
+#include <algorithm>
+
+void ReplayRing::init(size_t bits) {
+    size_t n = MIN_BITS;
+    while (n < bits && n < MAX_BITS) n <<= 1;
+    words_.assign(n / 64, 0);
+    mask_ = n - 1;
+}
+
+void ReplayRing::advance(uint64_t from, uint64_t to) {
+    if (words_.empty() || to <= from) return;
+    uint64_t n = to - from;
+    if (n >= bits()) {                      // the whole window slid past
+        std::fill(words_.begin(), words_.end(), 0);
+        return;
+    }
+    uint64_t p = (from + 1) & mask_;
+    while (n > 0) {
+        unsigned off = (unsigned)(p & 63);
+        uint64_t take = std::min<uint64_t>(n, 64 - off);
+        uint64_t bitsMask = (take == 64) ? ~0ULL : (((1ULL << take) - 1) << off);
+        words_[p >> 6] &= ~bitsMask;
+        p = (p + take) & mask_;
+        n -= take;
+    }
+}
@@ -0,0 +1,32 @@
+// /src/fresh/replay_window.h
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Anti-replay bitmap for windows wider than one 64-bit mask (RFC 4303 /
+// RFC 6479 style). Sequence number s maps to bit (s mod bits) of a ring of
+// uint64 words, so advancing the window head clears only the words it
+// passes over instead of shifting the whole array. The caller keeps the
+// highest seen sequence number and decides what is inside the window.
+class ReplayRing {
+  public:
+    static const size_t MIN_BITS = 128;
+    static const size_t MAX_BITS = 4096;
+
+    // bits is rounded up to a power of two in [MIN_BITS, MAX_BITS].
+    void init(size_t bits);
+    bool empty() const { return words_.empty(); }
+    size_t bits() const { return words_.size() * 64; }
+    size_t memoryBytes() const { return words_.size() * sizeof(uint64_t); }
+
+    bool test(uint64_t s) const { return (words_[(s & mask_) >> 6] >> (s & 63)) & 1u; }
+    void set(uint64_t s) { words_[(s & mask_) >> 6] |= 1ULL << (s & 63); }
+    // Moves the head from `from` to `to` (> from): clears the bits of the
+    // sequence numbers from+1..to, word by word.
+    void advance(uint64_t from, uint64_t to);
+
+  private:
+    std::vector<uint64_t> words_;
+    uint64_t mask_ = 0;     // bit index mask
+};
@@ -0,0 +1,123 @@
+// /src/fresh/source_table.h
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Per-source state table for the freshness stage.
+// Sources 0..dense-1 (the sensor indices) live in a contiguous array and are
+// found by indexing. Any other src (forged or unexpected) goes to a small
+// overflow table of fixed capacity with CLOCK (second-chance) replacement,
+// so hostile traffic cannot grow memory. With policy DROP a full overflow
+// table refuses new sources instead of evicting.
+// mapSources() makes the dense array hold a subset of the src range (one
+// gateway shard): slotOf[src] is the dense slot, -1 for foreign sources.
+// setDenseBase() does the same for a contiguous range without the map.
+template <class State>
+class SourceTable {
+  public:
+    enum Policy { EVICT, DROP };
+
+    void init(size_t dense, size_t overflowCapacity, Policy policy) {
+        dense_.assign(dense, State());
+        if (overflowCapacity < 1) overflowCapacity = 1;
+        slots_.assign(overflowCapacity, Slot());
+        index_.clear();
+        index_.reserve(overflowCapacity);
+        hand_ = 0;
+        policy_ = policy;
+        overflowLookups = overflowInserts = evictions = drops = 0;
+        slotOf_.clear();
+        base_ = 0;
+    }
+
+    // slotOf[src] in [0, denseSize()) or -1; call after init()
+    void mapSources(std::vector<int32_t> slotOf) { slotOf_ = std::move(slotOf); }
+    // dense array holds sources [first, first + denseSize()); call after init()
+    void setDenseBase(int first) { base_ = first; }
+
+    // src has a dense slot (a known sensor of this table)
+    bool hasDense(int src) const { return denseSlot(src) >= 0; }
+
+    // State for src, created on first use; nullptr if refused (DROP policy).
+    State* find(int src) {
+        int32_t slot = denseSlot(src);
+        if (slot >= 0) return &dense_[(size_t)slot];
+        overflowLookups++;
+        auto it = index_.find(src);
+        if (it != index_.end()) {
+            Slot& s = slots_[it->second];
+            s.ref = true;
+            return &s.state;
+        }
+        if (index_.size() >= slots_.size() && policy_ == DROP) {
+            drops++;
+            return nullptr;
+        }
+        // CLOCK: skip referenced slots once, clearing their bit
+        while (slots_[hand_].used && slots_[hand_].ref) {
+            slots_[hand_].ref = false;
+            hand_ = (hand_ + 1) % slots_.size();
+        }
+        Slot& victim = slots_[hand_];
+        if (victim.used) {
+            index_.erase(victim.src);
+            evictions++;
+        }
+        victim.src = src;
+        victim.used = true;
+        victim.ref = false;
+        victim.state = State();
+        index_.emplace(src, (uint32_t)hand_);
+        hand_ = (hand_ + 1) % slots_.size();
+        overflowInserts++;
+        return &victim.state;
+    }
+
+    // State for src if it already exists; never inserts or touches the CLOCK bits
+    const State* peek(int src) const {
+        int32_t slot = denseSlot(src);
+        if (slot >= 0) return &dense_[(size_t)slot];
+        auto it = index_.find(src);
+        return it != index_.end() ? &slots_[it->second].state : nullptr;
+    }
+
+    size_t denseSize() const { return dense_.size(); }
+    size_t overflowCapacity() const { return slots_.size(); }
+    size_t overflowSize() const { return index_.size(); }
+    // approximate resident memory (dense array + overflow slots + index)
+    size_t memoryBytes() const {
+        const size_t node = sizeof(void*) + sizeof(std::pair<const int, uint32_t>) + sizeof(void*);
+        return dense_.size() * sizeof(State) + slots_.size() * sizeof(Slot) + slotOf_.size() * sizeof(int32_t) +
+               index_.bucket_count() * sizeof(void*) + index_.size() * node;
+    }
+
+    long overflowLookups = 0;
+    long overflowInserts = 0;   // new unknown sources admitted
+    long evictions = 0;
+    long drops = 0;             // unknown sources refused (DROP policy)
+
+  private:
+    int32_t denseSlot(int src) const {
+        if (src < 0) return -1;
+        if (slotOf_.empty())
+            return src >= base_ && (size_t)(src - base_) < dense_.size() ? (int32_t)(src - base_) : -1;
+        return (size_t)src < slotOf_.size() ? slotOf_[(size_t)src] : -1;
+    }
+
+    struct Slot {
+        int src = 0;
+        bool used = false;
+        bool ref = false;   // second-chance bit
+        State state;
+    };
+    std::vector<State> dense_;
+    std::vector<Slot> slots_;
+    std::vector<int32_t> slotOf_;               // empty: src - base_ is the dense slot
+    int base_ = 0;
+    std::unordered_map<int, uint32_t> index_;   // src -> slot
+    size_t hand_ = 0;
+    Policy policy_ = EVICT;
+};
@@ -0,0 +1,23 @@
+// /src/net/shard_ring.cc
+#include "shard_ring.h"
+#include "../dedup/hash_policy.h"
+#include <algorithm>
+
+void ShardRing::init(int gateways, int vnodes) {
+    gateways_ = gateways < 1 ? 1 : gateways;
+    vnodes_ = vnodes < 1 ? 1 : vnodes;
+    points_.clear();
+    points_.reserve((size_t)gateways_ * (size_t)vnodes_);
+    for (int g = 0; g < gateways_; ++g)
+        for (int v = 0; v < vnodes_; ++v)
+            points_.emplace_back(SplitMixHashPolicy::hash(((uint64_t)(uint32_t)g << 32) | (uint32_t)v), g);
+    std::sort(points_.begin(), points_.end());
+}
+
+int ShardRing::shardOf(int sensor) const {
+    if (points_.empty()) return 0;
+    // sensor keys use a different domain than the vnode points
+    uint64_t h = SplitMixHashPolicy::hash((uint64_t)(uint32_t)sensor ^ 0x5eed5eed00000000ULL);
+    auto it = std::lower_bound(points_.begin(), points_.end(), std::make_pair(h, 0));
+    return it == points_.end() ? points_.front().second : it->second;
+}
@@ -0,0 +1,27 @@
+// /src/net/shard_ring.h
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Consistent-hash ring that assigns sensors to gateways. Each gateway owns
+// `vnodes` points on a 64-bit ring and a sensor belongs to the gateway of
+// the first point at or after hash(sensor), wrapping around. Going from G
+// to G+1 gateways moves only ~1/(G+1) of the sensors; more vnodes give a
+// more even split. The hash is fixed (splitmix64), independent of the
+// dedup hash policy, so the assignment is the same in every build.
+class ShardRing {
+  public:
+    // gateways < 1 -> 1, vnodes < 1 -> 1
+    void init(int gateways, int vnodes);
+
+    int shardOf(int sensor) const;
+    int gateways() const { return gateways_; }
+    int vnodes() const { return vnodes_; }
+
+  private:
+    std::vector<std::pair<uint64_t, int>> points_;   // (ring position, gateway), sorted
+    int gateways_ = 0;
+    int vnodes_ = 0;
+};